@@ -0,0 +1,111 @@
+//
+//  Archetype.cpp
+//  GameEngine
+//
+
+#include "Archetype.hpp"
+#include <cassert>
+#include <cstring>
+#include <new>
+
+ChunkPool::~ChunkPool()
+{
+    for (unsigned char* block : blocks)
+        ::operator delete(block);
+}
+
+unsigned char* ChunkPool::acquire()
+{
+    if (blocks.empty())
+    {
+        allocated++;
+        return static_cast<unsigned char*>(::operator new(Archetype::CHUNK_SIZE));
+    }
+    unsigned char* block = blocks.back();
+    blocks.pop_back();
+    return block;
+}
+
+void ChunkPool::release(unsigned char* block)
+{
+    blocks.push_back(block);
+}
+
+static uint32_t alignOffset(uint32_t offset, uint32_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+Archetype::Archetype(ComponentMask mask_) : mask(mask_), entityCount(0)
+{
+    for (int i = 0; i < Components::MAX_COMPONENTS; i++)
+    {
+        addEdges[i] = nullptr;
+        removeEdges[i] = nullptr;
+        offsets[i] = 0;
+        if ((mask >> i) & 1)
+            components.push_back(i);
+    }
+    
+    // as many rows as fit once every array starts 16 byte aligned
+    size_t rowSize = sizeof(Entity);
+    for (int component : components)
+        rowSize += Components::info(component).size;
+    // a row larger than a chunk is a bug in the component, not worth handling
+    capacity = (uint32_t)(CHUNK_SIZE / rowSize);
+    assert(capacity > 0);
+    for (;; capacity--)
+    {
+        uint32_t offset = alignOffset(capacity * (uint32_t)sizeof(Entity), 16);
+        for (int component : components)
+        {
+            offsets[component] = offset;
+            offset = alignOffset(offset + capacity * (uint32_t)Components::info(component).size, 16);
+        }
+        if (offset <= CHUNK_SIZE || capacity == 1)
+            break;
+    }
+}
+
+void Archetype::push(Entity entity, ChunkPool& pool, uint32_t& chunk, uint32_t& row)
+{
+    if (chunks.empty() || chunks.back().count == capacity)
+        chunks.push_back(Chunk{ pool.acquire(), 0 });
+    chunk = (uint32_t)chunks.size() - 1;
+    row = chunks.back().count++;
+    getEntities(chunks.back())[row] = entity;
+    entityCount++;
+}
+
+Entity Archetype::remove(uint32_t chunk, uint32_t row, ChunkPool& pool)
+{
+    Chunk& last = chunks.back();
+    uint32_t lastRow = last.count - 1;
+    Entity moved = Entity::null();
+    if (&chunks[chunk] != &last || row != lastRow)
+    {
+        Chunk& hole = chunks[chunk];
+        moved = getEntities(last)[lastRow];
+        getEntities(hole)[row] = moved;
+        for (int component : components)
+        {
+            size_t size = Components::info(component).size;
+            memcpy(hole.data + offsets[component] + row * size, last.data + offsets[component] + lastRow * size, size);
+        }
+    }
+    entityCount--;
+    if (--last.count == 0)
+    {
+        pool.release(last.data);
+        chunks.pop_back();
+    }
+    return moved;
+}
+
+void Archetype::releaseChunks(ChunkPool& pool)
+{
+    for (Chunk& chunk : chunks)
+        pool.release(chunk.data);
+    chunks.clear();
+    entityCount = 0;
+}
@@ -0,0 +1,90 @@
+//
+//  Archetype.hpp
+//  GameEngine
+//
+
+#ifndef Archetype_hpp
+#define Archetype_hpp
+
+#include "Component.hpp"
+#include "Entity.hpp"
+#include <stdint.h>
+#include <vector>
+
+// One block of CHUNK_SIZE bytes: the entity handles followed by one array
+// per component, each as long as the archetype's chunk capacity.
+struct Chunk
+{
+    unsigned char* data;
+    uint32_t count;
+};
+
+// Recycles chunk blocks, so entities coming and going at a steady count
+// do not touch the heap.
+class ChunkPool
+{
+public:
+    ChunkPool() = default;
+    ~ChunkPool();
+    ChunkPool(const ChunkPool&) = delete;
+    ChunkPool& operator=(const ChunkPool&) = delete;
+    
+    unsigned char* acquire();
+    void release(unsigned char* block);
+    size_t getAllocated() const { return allocated; }
+
+private:
+    std::vector<unsigned char*> blocks;
+    size_t allocated = 0;
+};
+
+// All entities with exactly one set of components. Chunks are kept full
+// except for the last one, a removed row is filled with the last entity.
+class Archetype
+{
+public:
+    static const size_t CHUNK_SIZE = 16 << 10;
+    
+    explicit Archetype(ComponentMask mask);
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+    
+    ComponentMask getMask() const { return mask; }
+    bool has(int component) const { return (mask >> component) & 1; }
+    const std::vector<int>& getComponents() const { return components; }
+    // entities per chunk
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getEntityCount() const { return entityCount; }
+    size_t getChunkCount() const { return chunks.size(); }
+    Chunk& getChunk(size_t index) { return chunks[index]; }
+    
+    Entity* getEntities(const Chunk& chunk) const { return (Entity*)chunk.data; }
+    void* getArray(const Chunk& chunk, int component) const { return chunk.data + offsets[component]; }
+    template<typename T>
+    T* getArray(const Chunk& chunk) const { return (T*)getArray(chunk, Components::id<T>()); }
+    void* getComponent(uint32_t chunk, uint32_t row, int component)
+    {
+        return chunks[chunk].data + offsets[component] + row * Components::info(component).size;
+    }
+    
+    // new row at the end, its components are left uninitialized
+    void push(Entity entity, ChunkPool& pool, uint32_t& chunk, uint32_t& row);
+    // fill the row with the last entity and return that entity, null if the
+    // row was the last one
+    Entity remove(uint32_t chunk, uint32_t row, ChunkPool& pool);
+    void releaseChunks(ChunkPool& pool);
+    
+    // archetype with one component more or less, filled in as moves happen
+    Archetype* addEdges[Components::MAX_COMPONENTS];
+    Archetype* removeEdges[Components::MAX_COMPONENTS];
+
+private:
+    ComponentMask mask;
+    std::vector<int> components;
+    uint32_t offsets[Components::MAX_COMPONENTS];
+    uint32_t capacity;
+    uint32_t entityCount;
+    std::vector<Chunk> chunks;
+};
+
+#endif /* Archetype_hpp */
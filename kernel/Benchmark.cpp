@@ -0,0 +1,412 @@
+//
+//  Benchmark.cpp
+//  GameEngine
+//
+
+#include "Benchmark.hpp"
+#include "Camera.hpp"
+#include "Frustum.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "Timer.hpp"
+#include "TransformHierarchy.hpp"
+#include "World.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+bool Benchmark::run(const std::string& name)
+{
+    if (name == "jobs")
+        jobScaling();
+    else if (name == "culling")
+        frustumCulling();
+    else if (name == "entities")
+        entities();
+    else if (name == "transforms")
+        transforms();
+    else if (name == "profiler")
+        profilerZones();
+    else
+    {
+        std::cerr << "unknown benchmark " << name << ", available: jobs, culling, entities, transforms, profiler"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+struct BenchTransform
+{
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+static void updateTransforms(BenchTransform* transforms, glm::mat4* world, uint32_t begin, uint32_t end, const glm::quat& spin)
+{
+    for (uint32_t i = begin; i < end; i++)
+    {
+        BenchTransform& t = transforms[i];
+        t.rotation = glm::normalize(spin * t.rotation);
+        world[i] = glm::translate(glm::mat4(1.0f), t.position) * glm::mat4_cast(t.rotation) * glm::scale(glm::mat4(1.0f), t.scale);
+    }
+}
+
+// best of a few runs, in ms
+template<typename F>
+static double measure(int runs, const F& function)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++)
+    {
+        int64_t start = Timer::nowNanos();
+        function();
+        best = std::min(best, (Timer::nowNanos() - start) * 1e-6);
+    }
+    return best;
+}
+
+void Benchmark::jobScaling()
+{
+    const uint32_t count = 1 << 20;
+    const uint32_t grain = 4096;
+    const int runs = 10;
+    
+    std::vector<BenchTransform> transforms(count);
+    std::vector<glm::mat4> world(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        transforms[i].position = glm::vec3((float)(i % 1024), (float)(i / 1024), 0.0f);
+        transforms[i].rotation = glm::angleAxis((float)i, glm::vec3(0.0f, 1.0f, 0.0f));
+        transforms[i].scale = glm::vec3(1.0f);
+    }
+    const glm::quat spin = glm::angleAxis(0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+    
+    double serial = measure(runs, [&]{
+        updateTransforms(transforms.data(), world.data(), 0, count, spin);
+    });
+    printf("transform update, %u transforms, grain %u\n", count, grain);
+    printf("%8s %10s %9s %11s\n", "threads", "ms", "speedup", "efficiency");
+    printf("%8s %10.3f %9.2f %10.0f%%\n", "serial", serial, 1.0, 100.0);
+    
+    int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> threadCounts;
+    for (int n = 1; n < hardware; n *= 2)
+        threadCounts.push_back(n);
+    threadCounts.push_back(hardware);
+    
+    for (int threads : threadCounts)
+    {
+        JobSystem::init(threads - 1);
+        // items each thread ran, a thread that never steals does not scale
+        std::vector<std::atomic<uint32_t>> items(threads);
+        for (std::atomic<uint32_t>& n : items)
+            n.store(0);
+        double parallel = measure(runs, [&]{
+            JobSystem::parallel_for(count, grain, [&](uint32_t begin, uint32_t end) {
+                updateTransforms(transforms.data(), world.data(), begin, end, spin);
+                items[JobSystem::getThreadIndex()].fetch_add(end - begin, std::memory_order_relaxed);
+            });
+        });
+        JobSystem::shutdown();
+        int busy = 0;
+        for (std::atomic<uint32_t>& n : items)
+            busy += n.load() > 0;
+        double speedup = serial / parallel;
+        printf("%8d %10.3f %9.2f %10.0f%%\n", threads, parallel, speedup, 100.0 * speedup / threads);
+        if (threads > 1 && busy < 2)
+            std::cerr << "only " << busy << " of " << threads << " threads ran any items" << std::endl;
+    }
+}
+
+void Benchmark::frustumCulling()
+{
+    const uint32_t count = 1000000;
+    const int runs = 20;
+    
+    // a scene of 2km around the camera, a few percent ends up visible
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> size(0.5f, 20.0f);
+    std::vector<float> x(count), y(count), z(count), radius(count);
+    std::vector<float> extentX(count), extentY(count), extentZ(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        x[i] = position(random);
+        y[i] = position(random);
+        z[i] = position(random);
+        extentX[i] = size(random);
+        extentY[i] = size(random);
+        extentZ[i] = size(random);
+        radius[i] = std::sqrt(extentX[i] * extentX[i] + extentY[i] * extentY[i] + extentZ[i] * extentZ[i]);
+    }
+    SphereArrays spheres = { x.data(), y.data(), z.data(), radius.data(), count };
+    BoxArrays boxes = { x.data(), y.data(), z.data(), extentX.data(), extentY.data(), extentZ.data(), count };
+    
+    Camera camera(1280, 960);
+    camera.init(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 45.0);
+    Frustum frustum(camera.getViewProjectionMatrix());
+    // every level the CPU has, the scalar one is the reference
+    const Frustum::SimdLevel best = Frustum::getSimdLevel();
+    const char* levelNames[] = { "scalar", "sse2", "avx2" };
+    std::vector<uint32_t> sphereReference(count), boxReference(count), visible(count);
+    uint32_t sphereReferenceCount = 0, boxReferenceCount = 0;
+    double bestBoxTime = 1e30;
+    bool mismatch = false;
+    
+    printf("frustum culling, %u objects, one thread\n", count);
+    printf("%-16s %10s %10s\n", "kernel", "ms", "visible");
+    for (int level = Frustum::SIMD_SCALAR; level <= best; level++)
+    {
+        Frustum::setSimdLimit((Frustum::SimdLevel)level);
+        uint32_t sphereCount = 0;
+        double sphereTime = measure(runs, [&]{
+            sphereCount = frustum.cullSpheres(spheres, visible.data());
+        });
+        if (level == Frustum::SIMD_SCALAR)
+        {
+            sphereReference = visible;
+            sphereReferenceCount = sphereCount;
+        }
+        else if (sphereCount != sphereReferenceCount ||
+                 !std::equal(visible.begin(), visible.begin() + sphereCount, sphereReference.begin()))
+        {
+            std::cerr << levelNames[level] << " spheres do not match the scalar result" << std::endl;
+            mismatch = true;
+        }
+        
+        uint32_t boxCount = 0;
+        double boxTime = measure(runs, [&]{
+            boxCount = frustum.cullBoxes(boxes, visible.data());
+        });
+        if (level == Frustum::SIMD_SCALAR)
+        {
+            boxReference = visible;
+            boxReferenceCount = boxCount;
+        }
+        else if (boxCount != boxReferenceCount ||
+                 !std::equal(visible.begin(), visible.begin() + boxCount, boxReference.begin()))
+        {
+            std::cerr << levelNames[level] << " boxes do not match the scalar result" << std::endl;
+            mismatch = true;
+        }
+        bestBoxTime = std::min(bestBoxTime, boxTime);
+        
+        printf("%-6s %-9s %10.3f %10u\n", levelNames[level], "spheres", sphereTime, sphereCount);
+        printf("%-6s %-9s %10.3f %10u\n", levelNames[level], "boxes", boxTime, boxCount);
+    }
+    Frustum::setSimdLimit(Frustum::SIMD_AVX2);
+    
+    if (!mismatch)
+        printf("every level matches the scalar result\n");
+    // the goal is a million boxes in under a millisecond on one core
+    if (bestBoxTime >= 1.0)
+        std::cerr << "culling " << count << " boxes took " << bestBoxTime << " ms, the target is under 1 ms" << std::endl;
+}
+
+struct BenchPosition
+{
+    glm::vec3 value;
+};
+
+struct BenchVelocity
+{
+    glm::vec3 value;
+};
+
+struct BenchTag
+{
+    uint32_t value;
+};
+
+void Benchmark::entities()
+{
+    const uint32_t count = 1 << 20;
+    const uint32_t moved = count / 10;
+    const int runs = 10;
+    const float dt = 1.0f / 60.0f;
+    
+    World world;
+    std::vector<Entity> handles(count);
+    double create = measure(1, [&]{
+        world.createMany<BenchPosition, BenchVelocity>(count, handles.data());
+    });
+    world.view<BenchVelocity>().each([](Entity entity, BenchVelocity& velocity) {
+        velocity.value = glm::vec3((float)(entity.index % 7), 1.0f, -(float)(entity.index % 3));
+    });
+    auto motion = [dt](uint32_t n, const Entity*, BenchPosition* positions, BenchVelocity* velocities) {
+        for (uint32_t i = 0; i < n; i++)
+            positions[i].value += velocities[i].value * dt;
+    };
+    
+    // the same loop over two flat arrays is the best case
+    std::vector<glm::vec3> flatPositions(count), flatVelocities(count, glm::vec3(1.0f));
+    double flat = measure(runs, [&]{
+        for (uint32_t i = 0; i < count; i++)
+            flatPositions[i] += flatVelocities[i] * dt;
+    });
+    View<BenchPosition, BenchVelocity> view = world.view<BenchPosition, BenchVelocity>();
+    double serial = measure(runs, [&]{ view.eachChunk(motion); });
+    JobSystem::init();
+    double parallel = measure(runs, [&]{ view.parallelEachChunk(motion); });
+    JobSystem::shutdown();
+    
+    // tag and untag a tenth of them, the second round reuses the chunks
+    double moves = 1e30;
+    size_t chunksBefore = 0;
+    for (int round = 0; round < 2; round++)
+    {
+        chunksBefore = world.getChunksAllocated();
+        moves = std::min(moves, measure(1, [&]{
+            for (uint32_t i = 0; i < moved; i++)
+                world.add<BenchTag>(handles[i * 10], BenchTag{ i });
+            for (uint32_t i = 0; i < moved; i++)
+                world.remove<BenchTag>(handles[i * 10]);
+        }));
+    }
+    
+    printf("entities, %u with position and velocity in %d chunks of %u\n", world.getEntityCount(),
+           (int)world.getChunkCount(), count / (uint32_t)world.getChunkCount());
+    printf("%-24s %10s\n", "", "ms");
+    printf("%-24s %10.3f\n", "create", create);
+    printf("%-24s %10.3f\n", "flat arrays", flat);
+    printf("%-24s %10.3f\n", "chunks, one thread", serial);
+    printf("%-24s %10.3f\n", "chunks, all threads", parallel);
+    printf("%-24s %10.3f  %u add + remove, %d new chunks in the last round\n", "archetype moves", moves, moved,
+           (int)(world.getChunksAllocated() - chunksBefore));
+}
+
+void Benchmark::transforms()
+{
+    const uint32_t count = 1 << 20;
+    const uint32_t roots = 1024;
+    const uint32_t dirty = count / 100;
+    const int runs = 10;
+    
+    // every node hangs below a random earlier one, about 8 levels deep
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+    TransformHierarchy hierarchy;
+    std::vector<uint32_t> nodes(count);
+    std::vector<uint32_t> parents(count, TransformHierarchy::INVALID);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (i >= roots)
+            parents[i] = nodes[std::max(i / 4, (uint32_t)(rng() % i))];
+        nodes[i] = hierarchy.create(parents[i]);
+        hierarchy.setPosition(nodes[i], glm::vec3(offset(rng), offset(rng), offset(rng)));
+        hierarchy.setRotation(nodes[i], glm::angleAxis(offset(rng), glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f))));
+        hierarchy.setBoundingRadius(nodes[i], 1.0f);
+    }
+    JobSystem::init();
+    uint64_t frame = 0;
+    double build = measure(1, [&]{ hierarchy.update(frame++); });
+    
+    // the same math node by node with glm, parents first
+    std::vector<glm::mat4> reference(count);
+    auto computeReference = [&]{
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t node = nodes[i];
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), hierarchy.getPosition(node)) *
+                              glm::mat4_cast(hierarchy.getRotation(node)) * glm::scale(glm::mat4(1.0f), hierarchy.getScale(node));
+            reference[i] = parents[i] == TransformHierarchy::INVALID ? local : reference[parents[i]] * local;
+        }
+    };
+    double scalar = measure(runs, computeReference);
+    // largest difference to the hierarchy's matrices, relative to the
+    // magnitude of each element
+    auto referenceError = [&]{
+        const glm::mat4* world = hierarchy.getWorldMatrices();
+        float error = 0.0f;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const glm::mat4& a = reference[i];
+            const glm::mat4& b = world[hierarchy.getSlot(nodes[i])];
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    error = std::max(error, std::abs(a[column][row] - b[column][row]) /
+                                            std::max(1.0f, std::abs(a[column][row])));
+        }
+        return error;
+    };
+    float buildError = referenceError();
+    
+    auto moveAll = [&]{
+        for (uint32_t i = 0; i < roots; i++)
+            hierarchy.setPosition(nodes[i], hierarchy.getPosition(nodes[i]) + glm::vec3(0.01f));
+        hierarchy.update(frame++);
+    };
+    double full = measure(runs, moveAll);
+    uint32_t fullUpdated = hierarchy.getUpdatedCount();
+    // let every buffer catch up before measuring partial updates
+    for (int i = 0; i < TransformHierarchy::BUFFERS; i++)
+        hierarchy.update(frame++);
+    double partial = measure(runs, [&]{
+        for (uint32_t i = 0; i < dirty; i++)
+        {
+            uint32_t node = nodes[rng() % count];
+            hierarchy.setScale(node, hierarchy.getScale(node));
+        }
+        hierarchy.update(frame++);
+    });
+    uint32_t partialUpdated = hierarchy.getUpdatedCount();
+    for (int i = 0; i < TransformHierarchy::BUFFERS; i++)
+        hierarchy.update(frame++);
+    double clean = measure(runs, [&]{ hierarchy.update(frame++); });
+    int threads = JobSystem::getThreadCount();
+    JobSystem::shutdown();
+    // after all the partial updates the buffer has to match from scratch
+    computeReference();
+    float finalError = referenceError();
+    
+    printf("transforms, %u nodes below %u roots, %d threads\n", count, roots, threads);
+    printf("%-24s %10s %10s\n", "", "ms", "updated");
+    printf("%-24s %10.3f %10u\n", "sort in and build", build, count);
+    printf("%-24s %10.3f %10u\n", "glm, node by node", scalar, count);
+    printf("%-24s %10.3f %10u\n", "all roots moved", full, fullUpdated);
+    printf("%-24s %10.3f %10u\n", "1% of the nodes changed", partial, partialUpdated);
+    printf("%-24s %10.3f %10u\n", "nothing changed", clean, hierarchy.getUpdatedCount());
+    printf("largest error against glm %g after the build, %g at the end\n", buildError, finalError);
+    if (buildError > 1e-4f || finalError > 1e-4f)
+        std::cerr << "world matrices do not match the glm reference" << std::endl;
+}
+
+void Benchmark::profilerZones()
+{
+    const uint32_t count = 1 << 22;
+    const int runs = 10;
+    // keeps the loops from being folded away
+    volatile uint32_t sink = 0;
+    
+    double empty = measure(runs, [&]{
+        for (uint32_t i = 0; i < count; i++)
+            sink = sink + 1;
+    });
+    // ProfileScope rather than PROFILE_SCOPE, so DISABLE_PROFILER builds measure it too
+    double zones = measure(runs, [&]{
+        for (uint32_t i = 0; i < count; i++)
+        {
+            ProfileScope zone("Benchmark zone");
+            sink = sink + 1;
+        }
+    });
+    double perZone = (zones - empty) * 1e6 / count;
+    
+    printf("profiler, %u empty zones on one thread\n", count);
+    printf("%-16s %10s %10s\n", "", "ms", "ns/zone");
+    printf("%-16s %10.3f\n", "empty loop", empty);
+    printf("%-16s %10.3f %10.1f\n", "with zones", zones, perZone);
+    // the budget that keeps zones cheap enough to leave in hot code
+    if (perZone >= 50.0)
+        std::cerr << "a zone costs " << perZone << " ns, the budget is under 50 ns" << std::endl;
+}
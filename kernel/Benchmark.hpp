@@ -0,0 +1,30 @@
+//
+//  Benchmark.hpp
+//  GameEngine
+//
+
+#ifndef Benchmark_hpp
+#define Benchmark_hpp
+
+#include <string>
+
+// Engine micro benchmarks, run with --bench <name> instead of opening a window.
+class Benchmark
+{
+public:
+    // false if there is no benchmark with that name
+    static bool run(const std::string& name);
+    
+    // parallel_for transform updates against a serial loop for 1..n threads
+    static void jobScaling();
+    // SIMD frustum culling of 1M spheres and boxes on one core
+    static void frustumCulling();
+    // 1M entity creation, chunk iteration and archetype moves
+    static void entities();
+    // 1M node hierarchy, full and partial world matrix updates
+    static void transforms();
+    // cost of one CPU profiler zone
+    static void profilerZones();
+};
+
+#endif /* Benchmark_hpp */
@@ -8,40 +8,34 @@
 
 #include <iostream>
 #include "Camera.hpp"
+#include "ViewRegistry.hpp"
 #include <glm/gtx/string_cast.hpp>
 
 using namespace glm;
 
-vec3 Camera::position;
-vec3 Camera::front;
-vec3 Camera::right;
-vec3 Camera::up;
-vec3 Camera::worldUp;
-mat4 Camera::projection;
-int Camera::width;
-int Camera::height;
-
-float Camera::Yaw;
-float Camera::Pitch;
-// camera options
-float Camera::MovementSpeed;
-float Camera::MouseSensitivity;
-float Camera::Zoom;
-
-bool Camera::cameraMoving;
-
-shared_ptr<Camera> Camera::camera;
-
 Camera::Camera(int width_, int height_)
 {
     width = width_;
     height = height_;
     front = glm::vec3(0, 0, -1);
+    orthographic = false;
+    orthoHalfWidth = 1.0f;
+    orthoHalfHeight = 1.0f;
+    nearPlane = NEAR_PLANE;
+    farPlane = FAR_PLANE;
+    viewDirty = true;
+    projectionDirty = true;
     MovementSpeed = SPEED;
     MouseSensitivity = SENSITIVITY;
     Zoom = ZOOM;
     init(vec3(0,20,15), vec3(0,1,0), 45.0);
 }
+
+Camera& Camera::get()
+{
+    return ViewRegistry::getCamera(ViewRegistry::MAIN_VIEW);
+}
+
 void Camera::init(glm::vec3 pos_, glm::vec3 up_, double fov_, float yaw, float pitch)
 {
     position = pos_;
@@ -49,43 +43,147 @@ void Camera::init(glm::vec3 pos_, glm::vec3 up_, double fov_, float yaw, float p
     worldUp = up;
     Yaw = yaw;
     Pitch = pitch;
+    Zoom = fov_;
     cameraMoving = false;
+    projectionDirty = true;
     updateCameraVectors();
 }
 
-float Camera::getFOV()
+void Camera::setPerspective(float fov, float nearPlane_, float farPlane_)
+{
+    orthographic = false;
+    Zoom = fov;
+    nearPlane = nearPlane_;
+    farPlane = farPlane_;
+    projectionDirty = true;
+}
+
+void Camera::setOrthographic(float halfWidth, float halfHeight, float nearPlane_, float farPlane_)
+{
+    orthographic = true;
+    orthoHalfWidth = halfWidth;
+    orthoHalfHeight = halfHeight;
+    nearPlane = nearPlane_;
+    farPlane = farPlane_;
+    projectionDirty = true;
+}
+
+void Camera::lookAt(glm::vec3 target)
+{
+    vec3 direction = normalize(target - position);
+    // straight up or down has no right vector, stay just short of it
+    Pitch = clamp(degrees(asin(clamp(direction.y, -1.0f, 1.0f))), -89.9f, 89.9f);
+    Yaw = degrees(atan2(direction.z, direction.x));
+    updateCameraVectors();
+}
+
+void Camera::setPosition(glm::vec3 pos_)
+{
+    position = pos_;
+    viewDirty = true;
+}
+
+float Camera::getFOV() const
 {
     return Zoom;
 }
 
+float Camera::getYaw() const
+{
+    return Yaw;
+}
+
+float Camera::getPitch() const
+{
+    return Pitch;
+}
+
+int Camera::getWidth() const
+{
+    return width;
+}
+
+int Camera::getHeight() const
+{
+    return height;
+}
+
+bool Camera::isOrthographic() const
+{
+    return orthographic;
+}
+
 void Camera::update_size(int width_, int height_)
 {
+    if(width_ == width && height_ == height)
+        return;
     width = width_;
     height = height_;
+    projectionDirty = true;
+}
+
+void Camera::updateMatrices() const
+{
+    if(viewDirty)
+    {
+        view = glm::lookAt(position, position+front, up);
+        inverseView = glm::inverse(view);
+    }
+    if(projectionDirty)
+    {
+        if(orthographic)
+            projection = ortho(-orthoHalfWidth, orthoHalfWidth, -orthoHalfHeight, orthoHalfHeight, nearPlane, farPlane);
+        else
+        {
+            // a minimized window reports 0x0
+            double aspect = height > 0 ? (double)width / (double)height : 1.0;
+            projection = perspective(glm::radians((double)Zoom), aspect, (double)nearPlane, (double)farPlane);
+        }
+        inverseProjection = glm::inverse(projection);
+    }
+    if(viewDirty || projectionDirty)
+    {
+        viewProjection = projection * view;
+        inverseViewProjection = inverseView * inverseProjection;
+    }
+    viewDirty = false;
+    projectionDirty = false;
 }
 
-glm::mat4 Camera::get_view()
+const glm::mat4& Camera::get_view() const
 {
-    return glm::lookAt(position, position+front, up);
+    updateMatrices();
+    return view;
 }
 
-glm::mat4 Camera::get_projection()
+const glm::mat4& Camera::get_projection() const
 {
-    return perspective(glm::radians((double)Zoom), (double)width / (double)height, 1.0, 1000.0);
+    updateMatrices();
+    return projection;
 }
 
-glm::mat4 Camera::getViewProjectionMatrix()
+const glm::mat4& Camera::getViewProjectionMatrix() const
 {
-    return get_projection() * get_view();
+    updateMatrices();
+    return viewProjection;
 }
 
-shared_ptr<Camera> Camera::getInstance()
+const glm::mat4& Camera::getInverseView() const
 {
-    if(camera == nullptr)
-    {
-        camera = make_shared<Camera>(1280, 960);
-    }
-    return camera;
+    updateMatrices();
+    return inverseView;
+}
+
+const glm::mat4& Camera::getInverseProjection() const
+{
+    updateMatrices();
+    return inverseProjection;
+}
+
+const glm::mat4& Camera::getInverseViewProjection() const
+{
+    updateMatrices();
+    return inverseViewProjection;
 }
 
 void Camera::ProcessKeyBoard(Camera_Movement direction, float deltaTime)
@@ -100,6 +198,7 @@ void Camera::ProcessKeyBoard(Camera_Movement direction, float deltaTime)
         position -= right * velocity;
     if(direction == RIGHT)
         position += right * velocity;
+    viewDirty = true;
 //    printf("position is (%f, %f, %f)\n", position.x, position.y, position.z);
     cameraMoving = false;
 }
@@ -130,6 +229,7 @@ void Camera::ProcessMouseScroll(float yoffset)
         Zoom = 1.0f;
     if(Zoom >= 45.0f)
         Zoom = 45.0f;
+    projectionDirty = true;
 }
 
 
@@ -142,14 +242,20 @@ void Camera::updateCameraVectors()
     front = normalize(front_);
     right = normalize(cross(front, worldUp));
     up = normalize(cross(right, front));
+    viewDirty = true;
 }
 
-bool Camera::isCameraMoved()
+bool Camera::isCameraMoved() const
 {
     return cameraMoving;
 }
 
-glm::vec3 Camera::getPosition()
+glm::vec3 Camera::getPosition() const
 {
     return position;
 }
+
+glm::vec3 Camera::getFront() const
+{
+    return front;
+}
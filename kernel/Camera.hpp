@@ -24,6 +24,8 @@ const float PITCH = 0.0f;
 const float SPEED = 100.0f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM   = 45.0f;
+const float NEAR_PLANE = 1.0f;
+const float FAR_PLANE = 1000.0f;
 
 enum Camera_Movement{
     FORWARD,
@@ -38,46 +40,75 @@ public:
     Camera(int width_, int height_);
     ~Camera() = default;
     
-    static void init(glm::vec3 pos_, glm::vec3 up_, double fov, float yaw = YAW, float pitch = PITCH);
-    static void update_size(int width_, int height_);
+    // the camera of the main view, see ViewRegistry for the others
+    static Camera& get();
     
-    static glm::mat4 get_view();
-    static glm::mat4 get_projection();
+    void init(glm::vec3 pos_, glm::vec3 up_, double fov, float yaw = YAW, float pitch = PITCH);
+    void update_size(int width_, int height_);
+    void setPerspective(float fov, float nearPlane = NEAR_PLANE, float farPlane = FAR_PLANE);
+    // box of halfWidth x halfHeight around the view axis, for shadow cascades
+    void setOrthographic(float halfWidth, float halfHeight, float nearPlane, float farPlane);
+    void lookAt(glm::vec3 target);
+    void setPosition(glm::vec3 pos_);
+    
+    // cached, only rebuilt after the camera changed
+    const glm::mat4& get_view() const;
+    const glm::mat4& get_projection() const;
     void rotate(glm::vec3 axis, float angle);
-    static glm::mat4 getViewProjectionMatrix();
-    static void ProcessKeyBoard(Camera_Movement direction, float deltaTime);
-    static void ProcessMouseMovement(float xoffset, float yoffset, bool constrainPitch = true);
-    static void ProcessMouseScroll(float yoffset);
-    static bool isCameraMoved();
+    const glm::mat4& getViewProjectionMatrix() const;
+    const glm::mat4& getInverseView() const;
+    const glm::mat4& getInverseProjection() const;
+    const glm::mat4& getInverseViewProjection() const;
+    void ProcessKeyBoard(Camera_Movement direction, float deltaTime);
+    void ProcessMouseMovement(float xoffset, float yoffset, bool constrainPitch = true);
+    void ProcessMouseScroll(float yoffset);
+    bool isCameraMoved() const;
     
-    static shared_ptr<Camera> getInstance();
-    static glm::vec3 getPosition();
-    static float getFOV();
+    glm::vec3 getPosition() const;
+    glm::vec3 getFront() const;
+    float getFOV() const;
+    float getYaw() const;
+    float getPitch() const;
+    int getWidth() const;
+    int getHeight() const;
+    bool isOrthographic() const;
     
 private:
-    static int width;
-    static int height;
+    int width;
+    int height;
 
-    static glm::vec3 position;
-    static glm::vec3 front;
-    static glm::vec3 right;
-    static glm::vec3 up;
-    static glm::vec3 worldUp;
+    glm::vec3 position;
+    glm::vec3 front;
+    glm::vec3 right;
+    glm::vec3 up;
+    glm::vec3 worldUp;
+    
+    bool orthographic;
+    float orthoHalfWidth;
+    float orthoHalfHeight;
+    float nearPlane;
+    float farPlane;
     
-    static glm::mat4 projection;
-    static bool cameraMoving;
+    mutable glm::mat4 view;
+    mutable glm::mat4 projection;
+    mutable glm::mat4 viewProjection;
+    mutable glm::mat4 inverseView;
+    mutable glm::mat4 inverseProjection;
+    mutable glm::mat4 inverseViewProjection;
+    mutable bool viewDirty;
+    mutable bool projectionDirty;
+    bool cameraMoving;
     
     // euler angles
-    static float Yaw;
-    static float Pitch;
+    float Yaw;
+    float Pitch;
     // camera options
-    static float MovementSpeed;
-    static float MouseSensitivity;
-    static float Zoom;
-    
-    static void updateCameraVectors();
+    float MovementSpeed;
+    float MouseSensitivity;
+    float Zoom;
     
-    static shared_ptr<Camera> camera;
+    void updateCameraVectors();
+    void updateMatrices() const;
 };
 
 #endif /* Camera_hpp */
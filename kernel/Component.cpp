@@ -0,0 +1,37 @@
+//
+//  Component.cpp
+//  GameEngine
+//
+
+#include "Component.hpp"
+#include <cassert>
+#include <iostream>
+#include <mutex>
+
+static ComponentInfo infos[Components::MAX_COMPONENTS];
+static int component_count = 0;
+static std::mutex registry_lock;
+
+int Components::registerType(size_t size, size_t alignment, const char* name)
+{
+    std::lock_guard<std::mutex> guard(registry_lock);
+    if (component_count == MAX_COMPONENTS)
+    {
+        std::cerr << "More than " << MAX_COMPONENTS << " component types, " << name << " does not fit" << std::endl;
+        assert(false);
+        return MAX_COMPONENTS - 1;
+    }
+    infos[component_count] = ComponentInfo{ size, alignment, name };
+    return component_count++;
+}
+
+const ComponentInfo& Components::info(int id)
+{
+    return infos[id];
+}
+
+int Components::count()
+{
+    std::lock_guard<std::mutex> guard(registry_lock);
+    return component_count;
+}
@@ -0,0 +1,64 @@
+//
+//  Component.hpp
+//  GameEngine
+//
+
+#ifndef Component_hpp
+#define Component_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <typeinfo>
+
+// one bit per component type
+typedef uint64_t ComponentMask;
+
+struct ComponentInfo
+{
+    size_t size;
+    size_t alignment;
+    const char* name;
+};
+
+// Component types get a small id the first time they are used. Components
+// are plain data: archetype moves copy them with memcpy and nothing is
+// ever destructed, so a move never allocates per entity.
+class Components
+{
+public:
+    static const int MAX_COMPONENTS = 64;
+    
+    template<typename T>
+    static int id();
+    template<typename... T>
+    static ComponentMask mask();
+    
+    static const ComponentInfo& info(int id);
+    static int count();
+    
+private:
+    // thread safe, ids are handed out in order of first use
+    static int registerType(size_t size, size_t alignment, const char* name);
+};
+
+template<typename T>
+int Components::id()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+    static_assert(std::is_trivially_destructible<T>::value, "components are never destructed");
+    static_assert(alignof(T) <= 16, "chunk arrays are aligned to 16 bytes");
+    static const int value = registerType(sizeof(T), alignof(T), typeid(T).name());
+    return value;
+}
+
+template<typename... T>
+ComponentMask Components::mask()
+{
+    ComponentMask result = 0;
+    int expand[] = { 0, (result |= ComponentMask(1) << id<T>(), 0)... };
+    (void)expand;
+    return result;
+}
+
+#endif /* Component_hpp */
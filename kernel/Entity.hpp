@@ -0,0 +1,25 @@
+//
+//  Entity.hpp
+//  GameEngine
+//
+
+#ifndef Entity_hpp
+#define Entity_hpp
+
+#include <stdint.h>
+
+// Generational handle. The index is reused after the entity is destroyed,
+// the generation is not, so an old handle never reaches the new entity.
+struct Entity
+{
+    uint32_t index;
+    // 0 is never alive
+    uint32_t generation;
+    
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+    bool isNull() const { return generation == 0; }
+    static Entity null() { return Entity{ 0xFFFFFFFF, 0 }; }
+};
+
+#endif /* Entity_hpp */
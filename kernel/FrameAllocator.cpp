@@ -0,0 +1,118 @@
+//
+//  FrameAllocator.cpp
+//  GameEngine
+//
+
+#include "FrameAllocator.hpp"
+#include "JobSystem.hpp"
+#include "../imgui/imgui.h"
+#include <stdio.h>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+// arenas[thread * FRAMES + slot]
+static std::vector<std::unique_ptr<LinearArena>> arenas;
+static std::unique_ptr<LinearArena> render_arena;
+static int current_slot = 0;
+
+void FrameAllocator::init(size_t bytesPerThread)
+{
+    int threads = JobSystem::getThreadCount();
+    if (threads < 1)
+        threads = 1;
+    arenas.clear();
+    for (int i = 0; i < threads * FRAMES; i++)
+        arenas.emplace_back(new LinearArena(bytesPerThread));
+    render_arena.reset(new LinearArena(bytesPerThread));
+    current_slot = 0;
+}
+
+void FrameAllocator::shutdown()
+{
+    arenas.clear();
+    render_arena.reset();
+}
+
+void FrameAllocator::beginFrame(uint64_t frame)
+{
+    // workers are idle between frames, jobs of the last frame were waited on
+    current_slot = (int)(frame % FRAMES);
+    int threads = (int)arenas.size() / FRAMES;
+    for (int thread = 0; thread < threads; thread++)
+        arenas[thread * FRAMES + current_slot]->reset();
+}
+
+void FrameAllocator::beginRender()
+{
+    render_arena->reset();
+}
+
+LinearArena& FrameAllocator::get()
+{
+    int thread = JobSystem::getThreadIndex();
+    assert(thread >= 0 && "only job threads have frame arenas, the render thread uses getRender");
+    assert(thread * FRAMES + current_slot < (int)arenas.size() && "FrameAllocator::init was not called");
+    return *arenas[thread * FRAMES + current_slot];
+}
+
+LinearArena& FrameAllocator::getRender()
+{
+    return *render_arena;
+}
+
+static void arenaRow(const char* name, const LinearArena& arena)
+{
+    ImGui::Text("%s", name);
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", arena.getLastUsed() / 1024.0);
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", arena.getHighWater() / 1024.0);
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", arena.getCapacity() / 1024.0);
+    ImGui::NextColumn();
+    ImGui::Text("%d", arena.getGrowCount());
+    ImGui::NextColumn();
+}
+
+void FrameAllocator::drawImGui()
+{
+    if (arenas.empty())
+    {
+        ImGui::TextDisabled("not initialized");
+        return;
+    }
+    ImGui::Columns(5, "frame_memory");
+    ImGui::Text("Arena");
+    ImGui::NextColumn();
+    ImGui::Text("Last KB");
+    ImGui::NextColumn();
+    ImGui::Text("Peak KB");
+    ImGui::NextColumn();
+    ImGui::Text("Size KB");
+    ImGui::NextColumn();
+    ImGui::Text("Grown");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    
+    // the slots of a thread are shown as one row: worst of its frames
+    int threads = (int)arenas.size() / FRAMES;
+    for (int thread = 0; thread < threads; thread++)
+    {
+        const LinearArena* worst = arenas[thread * FRAMES].get();
+        for (int slot = 1; slot < FRAMES; slot++)
+        {
+            const LinearArena* arena = arenas[thread * FRAMES + slot].get();
+            if (arena->getHighWater() > worst->getHighWater())
+                worst = arena;
+        }
+        char name[32];
+        if (thread == 0)
+            snprintf(name, sizeof(name), "Main");
+        else
+            snprintf(name, sizeof(name), "Worker %d", thread);
+        arenaRow(name, *worst);
+    }
+    arenaRow("Render", *render_arena);
+    ImGui::Columns(1);
+}
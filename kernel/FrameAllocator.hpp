@@ -0,0 +1,47 @@
+//
+//  FrameAllocator.hpp
+//  GameEngine
+//
+
+#ifndef FrameAllocator_hpp
+#define FrameAllocator_hpp
+
+#include "LinearArena.hpp"
+#include <stdint.h>
+
+// Transient per-frame memory. Every job thread owns one arena per frame in
+// flight, memory allocated while building frame N stays valid until frame
+// N + FRAMES starts, which covers a packet that is still waiting for or
+// being drawn by the render thread. The render thread has its own arena
+// that is reset at the start of every rendered frame.
+class FrameAllocator
+{
+public:
+    // one frame being built, one waiting in the mailbox, one being drawn
+    static const int FRAMES = 3;
+    
+    // after JobSystem::init, arenas grow on demand past the initial size
+    static void init(size_t bytesPerThread = 1 << 20);
+    static void shutdown();
+    
+    // main thread, start of a frame: recycles the arenas of frame - FRAMES
+    static void beginFrame(uint64_t frame);
+    // render thread, start of a rendered frame
+    static void beginRender();
+    
+    // arena of the calling job thread for the frame being built
+    static LinearArena& get();
+    // arena for the render thread, valid until the next beginRender
+    static LinearArena& getRender();
+    
+    // usage table, goes inside an ImGui window
+    static void drawImGui();
+};
+
+template<typename T>
+ArenaVector<T> makeFrameVector()
+{
+    return ArenaVector<T>(ArenaAllocator<T>(FrameAllocator::get()));
+}
+
+#endif /* FrameAllocator_hpp */
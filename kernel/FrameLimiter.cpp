@@ -0,0 +1,97 @@
+//
+//  FrameLimiter.cpp
+//  GameEngine
+//
+
+#include "FrameLimiter.hpp"
+#include "Timer.hpp"
+#include <chrono>
+#include <thread>
+
+FrameLimiter::FrameLimiter()
+{
+    period = 0;
+    // covers the usual timer slack of linux and macOS
+    spinThreshold = 2000000;
+    nextDeadline = 0;
+    lastError = 0;
+    averageError = 0.0;
+    maxError = 0;
+}
+
+void FrameLimiter::setTargetFPS(double fps)
+{
+    period = fps > 0.0 ? (int64_t)(1e9 / fps) : 0;
+    nextDeadline = 0;
+    lastError = 0;
+    averageError = 0.0;
+    maxError = 0;
+}
+
+double FrameLimiter::getTargetFPS() const
+{
+    return period > 0 ? 1e9 / period : 0.0;
+}
+
+void FrameLimiter::setSpinThreshold(double seconds)
+{
+    spinThreshold = (int64_t)(seconds * 1e9);
+}
+
+double FrameLimiter::getSpinThreshold() const
+{
+    return spinThreshold * 1e-9;
+}
+
+void FrameLimiter::wait()
+{
+    if(period == 0)
+        return;
+    
+    int64_t now = Timer::nowNanos();
+    if(nextDeadline == 0)
+        nextDeadline = now + period;
+    // a frame that overran has nothing to wait for, that is not pacing error
+    bool waited = now < nextDeadline;
+    
+    // coarse part, let the OS have the core
+    while(nextDeadline - now > spinThreshold)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(nextDeadline - now - spinThreshold));
+        now = Timer::nowNanos();
+    }
+    // fine part, spin on the clock until the deadline
+    while(now < nextDeadline)
+    {
+        std::this_thread::yield();
+        now = Timer::nowNanos();
+    }
+    
+    if(waited)
+    {
+        lastError = now - nextDeadline;
+        averageError = averageError * 0.95 + lastError * 0.05;
+        if(lastError > maxError)
+            maxError = lastError;
+    }
+    
+    // keep a steady cadence, unless we fell a whole frame behind
+    nextDeadline += period;
+    if(now > nextDeadline)
+        nextDeadline = now + period;
+}
+
+double FrameLimiter::getLastError() const
+{
+    return lastError * 1e-9;
+}
+
+double FrameLimiter::getAverageError() const
+{
+    return averageError * 1e-9;
+}
+
+double FrameLimiter::getMaxError() const
+{
+    return maxError * 1e-9;
+}
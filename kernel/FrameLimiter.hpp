@@ -0,0 +1,45 @@
+//
+//  FrameLimiter.hpp
+//  GameEngine
+//
+
+#ifndef FrameLimiter_hpp
+#define FrameLimiter_hpp
+
+#include <stdint.h>
+
+// Caps the frame rate by sleeping for most of the remaining frame time and
+// spinning for the last bit, the OS sleep alone is too coarse to pace frames.
+class FrameLimiter
+{
+public:
+    FrameLimiter();
+    ~FrameLimiter() = default;
+    
+    // 0 disables the limiter
+    void setTargetFPS(double fps);
+    double getTargetFPS() const;
+    // time before the deadline at which we stop sleeping and start spinning
+    void setSpinThreshold(double seconds);
+    double getSpinThreshold() const;
+    
+    // block until the current frame's deadline
+    void wait();
+    
+    // pacing error in seconds, how late we woke up relative to the deadline.
+    // frames that were already late do not count
+    double getLastError() const;
+    double getAverageError() const;
+    double getMaxError() const;
+    
+private:
+    int64_t period;
+    int64_t spinThreshold;
+    int64_t nextDeadline;
+    
+    int64_t lastError;
+    double averageError;
+    int64_t maxError;
+};
+
+#endif /* FrameLimiter_hpp */
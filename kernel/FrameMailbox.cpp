@@ -0,0 +1,66 @@
+//
+//  FrameMailbox.cpp
+//  GameEngine
+//
+
+#include "FrameMailbox.hpp"
+
+FrameMailbox::FrameMailbox()
+{
+    writeIndex = 0;
+    pendingIndex = -1;
+    readIndex = -1;
+    closed = false;
+}
+
+FramePacket& FrameMailbox::beginWrite()
+{
+    // the write slot is owned by the main thread, no lock needed
+    return slots[writeIndex];
+}
+
+void FrameMailbox::publish()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this]{ return pendingIndex == -1 || closed; });
+    if (closed)
+        return;
+    
+    pendingIndex = writeIndex;
+    // continue in the slot that is neither pending nor being rendered
+    for (int i = 0; i < SLOTS; i++)
+    {
+        if (i != pendingIndex && i != readIndex)
+        {
+            writeIndex = i;
+            break;
+        }
+    }
+    changed.notify_all();
+}
+
+const FramePacket* FrameMailbox::acquire()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this]{ return pendingIndex != -1 || closed; });
+    if (pendingIndex == -1)
+        return nullptr;
+    
+    readIndex = pendingIndex;
+    pendingIndex = -1;
+    changed.notify_all();
+    return &slots[readIndex];
+}
+
+void FrameMailbox::release()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    readIndex = -1;
+}
+
+void FrameMailbox::close()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    closed = true;
+    changed.notify_all();
+}
@@ -0,0 +1,49 @@
+//
+//  FrameMailbox.hpp
+//  GameEngine
+//
+
+#ifndef FrameMailbox_hpp
+#define FrameMailbox_hpp
+
+#include <mutex>
+#include <condition_variable>
+#include "FramePacket.hpp"
+
+// Triple buffered hand-off of frame packets from the main thread to the
+// render thread. At any time one packet is being written, one is pending
+// and one is being rendered, so the main thread can simulate frame N+1
+// while the render thread submits frame N.
+class FrameMailbox
+{
+public:
+    FrameMailbox();
+    ~FrameMailbox() = default;
+    
+    // main thread: the packet to fill for the next frame
+    FramePacket& beginWrite();
+    // main thread: hand the packet over, waits while the previous one
+    // has not been picked up yet so we never run more than a frame ahead
+    void publish();
+    
+    // render thread: wait for the next packet, nullptr once closed
+    const FramePacket* acquire();
+    // render thread: done with the packet returned by acquire
+    void release();
+    
+    // wake up the render thread and let it exit
+    void close();
+    
+private:
+    static const int SLOTS = 3;
+    FramePacket slots[SLOTS];
+    int writeIndex;
+    int pendingIndex;
+    int readIndex;
+    bool closed;
+    
+    std::mutex lock;
+    std::condition_variable changed;
+};
+
+#endif /* FrameMailbox_hpp */
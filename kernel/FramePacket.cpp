@@ -0,0 +1,63 @@
+//
+//  FramePacket.cpp
+//  GameEngine
+//
+
+#include "FramePacket.hpp"
+#include <string.h>
+
+template<typename T>
+static void copyVector(ImVector<T>& dst, const ImVector<T>& src)
+{
+    // ImVector::operator= frees first, resize keeps the capacity
+    dst.resize(src.Size);
+    if (src.Size > 0)
+        memcpy(dst.Data, src.Data, (size_t)src.Size * sizeof(T));
+}
+
+FramePacket::FramePacket()
+{
+    frameIndex = 0;
+    elapsedTime = 0.0f;
+    alpha = 1.0f;
+    width = 0;
+    height = 0;
+    viewCount = 0;
+    lods = nullptr;
+    objectCount = 0;
+    worldMatrices = nullptr;
+    inputTimestamp = 0;
+}
+
+FramePacket::~FramePacket()
+{
+    // drawData only points into drawLists
+    drawData.Clear();
+    for (int i = 0; i < drawLists.Size; i++)
+        IM_DELETE(drawLists[i]);
+}
+
+void FramePacket::captureDrawData(const ImDrawData* src)
+{
+    while (drawLists.Size < src->CmdListsCount)
+        drawLists.push_back(IM_NEW(ImDrawList)(NULL));
+    
+    for (int i = 0; i < src->CmdListsCount; i++)
+    {
+        const ImDrawList* from = src->CmdLists[i];
+        ImDrawList* to = drawLists[i];
+        copyVector(to->CmdBuffer, from->CmdBuffer);
+        copyVector(to->IdxBuffer, from->IdxBuffer);
+        copyVector(to->VtxBuffer, from->VtxBuffer);
+        to->Flags = from->Flags;
+    }
+    
+    drawData.Valid = src->Valid;
+    drawData.CmdLists = drawLists.Data;
+    drawData.CmdListsCount = src->CmdListsCount;
+    drawData.TotalIdxCount = src->TotalIdxCount;
+    drawData.TotalVtxCount = src->TotalVtxCount;
+    drawData.DisplayPos = src->DisplayPos;
+    drawData.DisplaySize = src->DisplaySize;
+    drawData.FramebufferScale = src->FramebufferScale;
+}
@@ -0,0 +1,78 @@
+//
+//  FramePacket.hpp
+//  GameEngine
+//
+
+#ifndef FramePacket_hpp
+#define FramePacket_hpp
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include "ViewRegistry.hpp"
+#include "../imgui/imgui.h"
+
+class RenderQueue;
+
+// One registered view as seen by the frame.
+struct FrameView
+{
+    int id;
+    const char* name;
+    int width;
+    int height;
+    uint32_t layerMask;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec3 position;
+    // slots of the render objects inside this view, lives in the frame arena
+    const uint32_t* visible;
+    uint32_t visibleCount;
+    // draws of this view in submission order, lives in the frame arena
+    const RenderQueue* queue;
+};
+
+// Everything the render thread needs to draw one frame. Built by the main
+// thread, never touched by it again once published, so the render thread
+// can read it without locks.
+struct FramePacket
+{
+    FramePacket();
+    ~FramePacket();
+    FramePacket(const FramePacket&) = delete;
+    FramePacket& operator=(const FramePacket&) = delete;
+    
+    uint64_t frameIndex;
+    float elapsedTime;
+    // interpolation factor between the last two simulation ticks
+    float alpha;
+    // framebuffer size
+    int width;
+    int height;
+    
+    // enabled views, views[0] is always the main view since it can be
+    // neither destroyed nor disabled
+    FrameView views[ViewRegistry::MAX_VIEWS];
+    int viewCount;
+    const FrameView& mainView() const { return views[0]; }
+    // per object level of detail, picked once for all views, only set for
+    // objects that are visible in at least one view
+    const uint8_t* lods;
+    uint32_t objectCount;
+    // world matrix of every object by slot, for instancing. Points into the
+    // transform buffer of this frame, which is not written again until the
+    // frame arena is reused
+    const glm::mat4* worldMatrices;
+    // oldest input event the camera state includes, 0 if none
+    int64_t inputTimestamp;
+    
+    // deep copy of the ui, the ImGui context moves on to the next frame
+    ImDrawData drawData;
+    void captureDrawData(const ImDrawData* src);
+    
+private:
+    // draw lists are reused across frames so copying does not allocate
+    ImVector<ImDrawList*> drawLists;
+};
+
+#endif /* FramePacket_hpp */
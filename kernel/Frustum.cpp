@@ -0,0 +1,359 @@
+//
+//  Frustum.cpp
+//  GameEngine
+//
+
+#include "Frustum.hpp"
+#include <atomic>
+#include <cmath>
+
+static std::atomic<int> simd_limit(Frustum::SIMD_AVX2);
+
+Frustum::Frustum(const glm::mat4& m)
+{
+    // Gribb/Hartmann: rows of the matrix combined, glm is column major
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    planes[LEFT_SIDE] = row3 + row0;
+    planes[RIGHT_SIDE] = row3 - row0;
+    planes[BOTTOM_SIDE] = row3 + row1;
+    planes[TOP_SIDE] = row3 - row1;
+    planes[NEAR_SIDE] = row3 + row2;
+    planes[FAR_SIDE] = row3 - row2;
+    // normalized so the distance test works for spheres
+    for (int i = 0; i < PLANES; i++)
+    {
+        glm::vec4& plane = planes[i];
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        plane = plane * (1.0f / length);
+    }
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const
+{
+    for (int i = 0; i < PLANES; i++)
+    {
+        const glm::vec4& plane = planes[i];
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersectsBox(const glm::vec3& minimum, const glm::vec3& maximum) const
+{
+    for (int i = 0; i < PLANES; i++)
+    {
+        const glm::vec4& plane = planes[i];
+        // the corner furthest along the plane normal
+        float x = plane.x >= 0.0f ? maximum.x : minimum.x;
+        float y = plane.y >= 0.0f ? maximum.y : minimum.y;
+        float z = plane.z >= 0.0f ? maximum.z : minimum.z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// The batched kernels test every plane as d + r < 0, d being the signed
+// distance of the center and r the radius, or for boxes the extent
+// projected onto the plane normal. The sign bits of all six sums are or-ed,
+// a set sign bit means the object is outside at least one plane.
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FRUSTUM_SIMD 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2,fma,popcnt")))
+
+static bool hasAVX2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+}
+
+Frustum::SimdLevel Frustum::getSimdLevel()
+{
+    SimdLevel supported = hasAVX2() ? SIMD_AVX2 : SIMD_SSE2;
+    SimdLevel limit = (SimdLevel)simd_limit.load(std::memory_order_relaxed);
+    return limit < supported ? limit : supported;
+}
+
+// For every 8 bit visibility mask the lanes to keep, packed as nibbles,
+// so one permute compacts the visible indices to the front.
+struct CompactTable
+{
+    uint32_t lanes[256];
+    CompactTable()
+    {
+        for (uint32_t mask = 0; mask < 256; mask++)
+        {
+            uint32_t packed = 0;
+            int slot = 0;
+            for (uint32_t lane = 0; lane < 8; lane++)
+            {
+                if (mask & (1u << lane))
+                    packed |= lane << (4 * slot++);
+            }
+            lanes[mask] = packed;
+        }
+    }
+};
+static const CompactTable compactTable;
+
+AVX2_TARGET static inline __m256 sphereOutside8(const glm::vec4* planes, const SphereArrays& s, uint32_t i)
+{
+    __m256 x = _mm256_loadu_ps(s.x + i);
+    __m256 y = _mm256_loadu_ps(s.y + i);
+    __m256 z = _mm256_loadu_ps(s.z + i);
+    __m256 r = _mm256_loadu_ps(s.radius + i);
+    __m256 outside = _mm256_setzero_ps();
+    for (int p = 0; p < Frustum::PLANES; p++)
+    {
+        __m256 d = _mm256_fmadd_ps(_mm256_set1_ps(planes[p].x), x, _mm256_set1_ps(planes[p].w));
+        d = _mm256_fmadd_ps(_mm256_set1_ps(planes[p].y), y, d);
+        d = _mm256_fmadd_ps(_mm256_set1_ps(planes[p].z), z, d);
+        outside = _mm256_or_ps(outside, _mm256_add_ps(d, r));
+    }
+    return outside;
+}
+
+AVX2_TARGET static inline __m256 boxOutside8(const glm::vec4* planes, const glm::vec4* absPlanes, const BoxArrays& b, uint32_t i)
+{
+    __m256 cx = _mm256_loadu_ps(b.centerX + i);
+    __m256 cy = _mm256_loadu_ps(b.centerY + i);
+    __m256 cz = _mm256_loadu_ps(b.centerZ + i);
+    __m256 ex = _mm256_loadu_ps(b.extentX + i);
+    __m256 ey = _mm256_loadu_ps(b.extentY + i);
+    __m256 ez = _mm256_loadu_ps(b.extentZ + i);
+    __m256 outside = _mm256_setzero_ps();
+    for (int p = 0; p < Frustum::PLANES; p++)
+    {
+        __m256 d = _mm256_fmadd_ps(_mm256_set1_ps(planes[p].x), cx, _mm256_set1_ps(planes[p].w));
+        d = _mm256_fmadd_ps(_mm256_set1_ps(planes[p].y), cy, d);
+        d = _mm256_fmadd_ps(_mm256_set1_ps(planes[p].z), cz, d);
+        d = _mm256_fmadd_ps(_mm256_set1_ps(absPlanes[p].x), ex, d);
+        d = _mm256_fmadd_ps(_mm256_set1_ps(absPlanes[p].y), ey, d);
+        d = _mm256_fmadd_ps(_mm256_set1_ps(absPlanes[p].z), ez, d);
+        outside = _mm256_or_ps(outside, d);
+    }
+    return outside;
+}
+
+// Writes all 8 lanes, the caller guarantees out + 8 stays inside the
+// buffer: out never runs ahead of the input index.
+AVX2_TARGET static inline uint32_t* compact8(__m256 outside, __m256i indices, uint32_t* out)
+{
+    int mask = ~_mm256_movemask_ps(outside) & 0xff;
+    __m256i shift = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    __m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)compactTable.lanes[mask]), shift), _mm256_set1_epi32(7));
+    _mm256_storeu_si256((__m256i*)out, _mm256_permutevar8x32_epi32(indices, lanes));
+    return out + _mm_popcnt_u32((unsigned)mask);
+}
+
+AVX2_TARGET static uint32_t cullSpheresAVX2(const glm::vec4* planes, const SphereArrays& s, uint32_t* visible, uint32_t offset, uint32_t& done)
+{
+    uint32_t* out = visible;
+    __m256i indices = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)offset));
+    const __m256i step = _mm256_set1_epi32(8);
+    uint32_t i = 0;
+    for (; i + 8 <= s.count; i += 8)
+    {
+        out = compact8(sphereOutside8(planes, s, i), indices, out);
+        indices = _mm256_add_epi32(indices, step);
+    }
+    done = i;
+    return (uint32_t)(out - visible);
+}
+
+AVX2_TARGET static uint32_t cullBoxesAVX2(const glm::vec4* planes, const glm::vec4* absPlanes, const BoxArrays& b, uint32_t* visible, uint32_t offset, uint32_t& done)
+{
+    uint32_t* out = visible;
+    __m256i indices = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)offset));
+    const __m256i step = _mm256_set1_epi32(8);
+    uint32_t i = 0;
+    for (; i + 8 <= b.count; i += 8)
+    {
+        out = compact8(boxOutside8(planes, absPlanes, b, i), indices, out);
+        indices = _mm256_add_epi32(indices, step);
+    }
+    done = i;
+    return (uint32_t)(out - visible);
+}
+
+AVX2_TARGET static uint32_t markSpheresAVX2(const glm::vec4* planes, const SphereArrays& s, uint32_t bit, uint32_t* masks)
+{
+    const __m256i bits = _mm256_set1_epi32((int)bit);
+    uint32_t i = 0;
+    for (; i + 8 <= s.count; i += 8)
+    {
+        __m256i outside = _mm256_srai_epi32(_mm256_castps_si256(sphereOutside8(planes, s, i)), 31);
+        __m256i mask = _mm256_loadu_si256((const __m256i*)(masks + i));
+        mask = _mm256_or_si256(mask, _mm256_andnot_si256(outside, bits));
+        _mm256_storeu_si256((__m256i*)(masks + i), mask);
+    }
+    return i;
+}
+
+static inline __m128 sphereOutside4(const glm::vec4* planes, const SphereArrays& s, uint32_t i)
+{
+    __m128 x = _mm_loadu_ps(s.x + i);
+    __m128 y = _mm_loadu_ps(s.y + i);
+    __m128 z = _mm_loadu_ps(s.z + i);
+    __m128 r = _mm_loadu_ps(s.radius + i);
+    __m128 outside = _mm_setzero_ps();
+    for (int p = 0; p < Frustum::PLANES; p++)
+    {
+        __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), x), _mm_set1_ps(planes[p].w));
+        d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].y), y), d);
+        d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), z), d);
+        outside = _mm_or_ps(outside, _mm_add_ps(d, r));
+    }
+    return outside;
+}
+
+static inline __m128 boxOutside4(const glm::vec4* planes, const glm::vec4* absPlanes, const BoxArrays& b, uint32_t i)
+{
+    __m128 cx = _mm_loadu_ps(b.centerX + i);
+    __m128 cy = _mm_loadu_ps(b.centerY + i);
+    __m128 cz = _mm_loadu_ps(b.centerZ + i);
+    __m128 ex = _mm_loadu_ps(b.extentX + i);
+    __m128 ey = _mm_loadu_ps(b.extentY + i);
+    __m128 ez = _mm_loadu_ps(b.extentZ + i);
+    __m128 outside = _mm_setzero_ps();
+    for (int p = 0; p < Frustum::PLANES; p++)
+    {
+        __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), cx), _mm_set1_ps(planes[p].w));
+        d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].y), cy), d);
+        d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), cz), d);
+        d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(absPlanes[p].x), ex), d);
+        d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(absPlanes[p].y), ey), d);
+        d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(absPlanes[p].z), ez), d);
+        outside = _mm_or_ps(outside, d);
+    }
+    return outside;
+}
+
+static inline uint32_t* compact4(__m128 outside, uint32_t base, uint32_t* out)
+{
+    for (int mask = ~_mm_movemask_ps(outside) & 0xf; mask; mask &= mask - 1)
+        *out++ = base + (uint32_t)__builtin_ctz((unsigned)mask);
+    return out;
+}
+
+static uint32_t cullSpheresSSE(const glm::vec4* planes, const SphereArrays& s, uint32_t* visible, uint32_t offset, uint32_t& done)
+{
+    uint32_t* out = visible;
+    uint32_t i = 0;
+    for (; i + 4 <= s.count; i += 4)
+        out = compact4(sphereOutside4(planes, s, i), i + offset, out);
+    done = i;
+    return (uint32_t)(out - visible);
+}
+
+static uint32_t cullBoxesSSE(const glm::vec4* planes, const glm::vec4* absPlanes, const BoxArrays& b, uint32_t* visible, uint32_t offset, uint32_t& done)
+{
+    uint32_t* out = visible;
+    uint32_t i = 0;
+    for (; i + 4 <= b.count; i += 4)
+        out = compact4(boxOutside4(planes, absPlanes, b, i), i + offset, out);
+    done = i;
+    return (uint32_t)(out - visible);
+}
+
+static uint32_t markSpheresSSE(const glm::vec4* planes, const SphereArrays& s, uint32_t bit, uint32_t* masks)
+{
+    const __m128i bits = _mm_set1_epi32((int)bit);
+    uint32_t i = 0;
+    for (; i + 4 <= s.count; i += 4)
+    {
+        __m128i outside = _mm_srai_epi32(_mm_castps_si128(sphereOutside4(planes, s, i)), 31);
+        __m128i mask = _mm_loadu_si128((const __m128i*)(masks + i));
+        _mm_storeu_si128((__m128i*)(masks + i), _mm_or_si128(mask, _mm_andnot_si128(outside, bits)));
+    }
+    return i;
+}
+#else
+Frustum::SimdLevel Frustum::getSimdLevel()
+{
+    return SIMD_SCALAR;
+}
+#endif
+
+static inline bool boxVisible(const glm::vec4* planes, const BoxArrays& b, uint32_t i)
+{
+    for (int p = 0; p < Frustum::PLANES; p++)
+    {
+        const glm::vec4& plane = planes[p];
+        float d = plane.x * b.centerX[i] + plane.y * b.centerY[i] + plane.z * b.centerZ[i] + plane.w
+                + std::fabs(plane.x) * b.extentX[i] + std::fabs(plane.y) * b.extentY[i] + std::fabs(plane.z) * b.extentZ[i];
+        if (d < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+uint32_t Frustum::cullSpheres(const SphereArrays& s, uint32_t* visible, uint32_t indexOffset) const
+{
+    uint32_t done = 0;
+    uint32_t count = 0;
+#ifdef FRUSTUM_SIMD
+    SimdLevel level = getSimdLevel();
+    if (level == SIMD_AVX2)
+        count = cullSpheresAVX2(planes, s, visible, indexOffset, done);
+    else if (level == SIMD_SSE2)
+        count = cullSpheresSSE(planes, s, visible, indexOffset, done);
+#endif
+    // the tail that does not fill a batch
+    for (uint32_t i = done; i < s.count; i++)
+    {
+        if (intersectsSphere(glm::vec3(s.x[i], s.y[i], s.z[i]), s.radius[i]))
+            visible[count++] = i + indexOffset;
+    }
+    return count;
+}
+
+uint32_t Frustum::cullBoxes(const BoxArrays& b, uint32_t* visible, uint32_t indexOffset) const
+{
+    uint32_t done = 0;
+    uint32_t count = 0;
+#ifdef FRUSTUM_SIMD
+    glm::vec4 absPlanes[PLANES];
+    for (int p = 0; p < PLANES; p++)
+        absPlanes[p] = glm::vec4(std::fabs(planes[p].x), std::fabs(planes[p].y), std::fabs(planes[p].z), 0.0f);
+    SimdLevel level = getSimdLevel();
+    if (level == SIMD_AVX2)
+        count = cullBoxesAVX2(planes, absPlanes, b, visible, indexOffset, done);
+    else if (level == SIMD_SSE2)
+        count = cullBoxesSSE(planes, absPlanes, b, visible, indexOffset, done);
+#endif
+    for (uint32_t i = done; i < b.count; i++)
+    {
+        if (boxVisible(planes, b, i))
+            visible[count++] = i + indexOffset;
+    }
+    return count;
+}
+
+void Frustum::markSpheres(const SphereArrays& s, uint32_t bit, uint32_t* masks) const
+{
+    uint32_t done = 0;
+#ifdef FRUSTUM_SIMD
+    SimdLevel level = getSimdLevel();
+    if (level == SIMD_AVX2)
+        done = markSpheresAVX2(planes, s, bit, masks);
+    else if (level == SIMD_SSE2)
+        done = markSpheresSSE(planes, s, bit, masks);
+#endif
+    for (uint32_t i = done; i < s.count; i++)
+    {
+        if (intersectsSphere(glm::vec3(s.x[i], s.y[i], s.z[i]), s.radius[i]))
+            masks[i] |= bit;
+    }
+}
+
+void Frustum::setSimdLimit(SimdLevel limit)
+{
+    simd_limit.store(limit, std::memory_order_relaxed);
+}
@@ -0,0 +1,64 @@
+//
+//  Frustum.hpp
+//  GameEngine
+//
+
+#ifndef Frustum_hpp
+#define Frustum_hpp
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+
+// Bounding spheres as structure of arrays for the batched kernels.
+// No alignment needed, count does not have to be a multiple of 8.
+struct SphereArrays
+{
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* radius;
+    uint32_t count;
+};
+
+// Axis aligned boxes in center / half extent form.
+struct BoxArrays
+{
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* extentX;
+    const float* extentY;
+    const float* extentZ;
+    uint32_t count;
+};
+
+// Six planes pointing inwards, ax + by + cz + d >= 0 is inside.
+struct Frustum
+{
+    enum { LEFT_SIDE, RIGHT_SIDE, BOTTOM_SIDE, TOP_SIDE, NEAR_SIDE, FAR_SIDE, PLANES };
+    enum SimdLevel { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+    glm::vec4 planes[PLANES];
+    
+    Frustum() = default;
+    // from a view-projection matrix, planes come out in world space
+    explicit Frustum(const glm::mat4& viewProjection);
+    
+    bool intersectsSphere(const glm::vec3& center, float radius) const;
+    bool intersectsBox(const glm::vec3& minimum, const glm::vec3& maximum) const;
+    
+    // Batched tests, 8 objects at a time with AVX2 and 4 with SSE2, picked
+    // at runtime. visible receives the indices of the objects that pass in
+    // increasing order and needs room for count entries, returns how many
+    // passed. indexOffset is added to every written index.
+    uint32_t cullSpheres(const SphereArrays& spheres, uint32_t* visible, uint32_t indexOffset = 0) const;
+    uint32_t cullBoxes(const BoxArrays& boxes, uint32_t* visible, uint32_t indexOffset = 0) const;
+    // multi view variant: sets bit in masks[i] for every visible sphere
+    void markSpheres(const SphereArrays& spheres, uint32_t bit, uint32_t* masks) const;
+    
+    // the batched tests use the best level the CPU supports. lower the limit
+    // to compare the paths, not while anything is culling
+    static void setSimdLimit(SimdLevel limit);
+    static SimdLevel getSimdLevel();
+};
+
+#endif /* Frustum_hpp */
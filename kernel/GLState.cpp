@@ -0,0 +1,388 @@
+//
+//  GLState.cpp
+//  GameEngine
+//
+
+#include "GLState.hpp"
+#include "../imgui/imgui.h"
+#include <atomic>
+
+// never a valid name or enum, so the first call always differs
+static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+static const GLenum buffer_targets[] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER,
+    GL_PIXEL_UNPACK_BUFFER };
+static const int BUFFER_TARGETS = sizeof(buffer_targets) / sizeof(buffer_targets[0]);
+static const GLenum texture_targets[] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D };
+static const int TEXTURE_TARGETS = sizeof(texture_targets) / sizeof(texture_targets[0]);
+static const GLenum capabilities[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST };
+static const int CAPABILITIES = sizeof(capabilities) / sizeof(capabilities[0]);
+
+struct Rect
+{
+    GLint x, y;
+    GLsizei width, height;
+    bool known;
+};
+
+struct BufferRange
+{
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+static GLuint program = UNKNOWN;
+static GLuint vertex_array = UNKNOWN;
+static GLuint buffers[BUFFER_TARGETS];
+static BufferRange uniform_ranges[GLState::UNIFORM_BINDINGS];
+static GLuint active_unit = UNKNOWN;
+static GLuint textures[GLState::TEXTURE_UNITS][TEXTURE_TARGETS];
+// -1 unknown
+static int enabled[CAPABILITIES] = { -1, -1, -1, -1 };
+static GLenum blend_func[4] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+static GLenum blend_equation = UNKNOWN;
+static GLenum depth_func = UNKNOWN;
+static int depth_mask = -1;
+static GLenum cull_face = UNKNOWN;
+static Rect scissor_box = {};
+static Rect viewport_rect = {};
+
+// counted by the GL thread only
+static uint32_t issued[GLState::CATEGORIES];
+static uint32_t filtered[GLState::CATEGORIES];
+// totals of the last frame, read by the ui on the main thread
+static std::atomic<uint32_t> last_issued[GLState::CATEGORIES];
+static std::atomic<uint32_t> last_filtered[GLState::CATEGORIES];
+
+static const char* category_names[GLState::CATEGORIES] = { "Program", "Vertex array", "Buffer", "Texture",
+    "Enable", "Blend", "Depth", "Cull", "Scissor", "Viewport" };
+
+static int indexOf(const GLenum* values, int count, GLenum value)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (values[i] == value)
+            return i;
+    }
+    return -1;
+}
+
+// Count the call, returns true if it has to be issued.
+static inline bool changed(GLState::Category category, bool differs)
+{
+    if (differs)
+        issued[category]++;
+    else
+        filtered[category]++;
+    return differs;
+}
+
+void GLState::invalidate()
+{
+    program = UNKNOWN;
+    vertex_array = UNKNOWN;
+    for (GLuint& buffer : buffers)
+        buffer = UNKNOWN;
+    for (BufferRange& range : uniform_ranges)
+        range.buffer = UNKNOWN;
+    active_unit = UNKNOWN;
+    for (auto& unit : textures)
+    {
+        for (GLuint& texture : unit)
+            texture = UNKNOWN;
+    }
+    for (int& capability : enabled)
+        capability = -1;
+    for (GLenum& func : blend_func)
+        func = UNKNOWN;
+    blend_equation = UNKNOWN;
+    depth_func = UNKNOWN;
+    depth_mask = -1;
+    cull_face = UNKNOWN;
+    scissor_box.known = false;
+    viewport_rect.known = false;
+}
+
+// the shadow starts out unknown before the first call
+static struct InitialState
+{
+    InitialState() { GLState::invalidate(); }
+} initial_state;
+
+void GLState::beginFrame()
+{
+    for (int i = 0; i < CATEGORIES; i++)
+    {
+        last_issued[i].store(issued[i], std::memory_order_relaxed);
+        last_filtered[i].store(filtered[i], std::memory_order_relaxed);
+        issued[i] = 0;
+        filtered[i] = 0;
+    }
+}
+
+void GLState::useProgram(GLuint program_)
+{
+    if (changed(PROGRAM, program != program_))
+    {
+        program = program_;
+        glUseProgram(program_);
+    }
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+    if (changed(VERTEX_ARRAY, vertex_array != vao))
+    {
+        vertex_array = vao;
+        buffers[indexOf(buffer_targets, BUFFER_TARGETS, GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+        glBindVertexArray(vao);
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+    int index = indexOf(buffer_targets, BUFFER_TARGETS, target);
+    if (changed(BUFFER, index < 0 || buffers[index] != buffer))
+    {
+        if (index >= 0)
+            buffers[index] = buffer;
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    bool shadowed = target == GL_UNIFORM_BUFFER && index < (GLuint)UNIFORM_BINDINGS;
+    if (shadowed)
+    {
+        BufferRange& range = uniform_ranges[index];
+        if (!changed(BUFFER, range.buffer != buffer || range.offset != offset || range.size != size))
+            return;
+        range = BufferRange{ buffer, offset, size };
+        buffers[indexOf(buffer_targets, BUFFER_TARGETS, GL_UNIFORM_BUFFER)] = buffer;
+    }
+    else
+    {
+        changed(BUFFER, true);
+        int generic = indexOf(buffer_targets, BUFFER_TARGETS, target);
+        if (generic >= 0)
+            buffers[generic] = buffer;
+    }
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    // a whole buffer binding is not a range, remember it as size -1
+    bool shadowed = target == GL_UNIFORM_BUFFER && index < (GLuint)UNIFORM_BINDINGS;
+    if (shadowed)
+    {
+        BufferRange& range = uniform_ranges[index];
+        if (!changed(BUFFER, range.buffer != buffer || range.offset != 0 || range.size != -1))
+            return;
+        range = BufferRange{ buffer, 0, -1 };
+    }
+    else
+        changed(BUFFER, true);
+    int generic = indexOf(buffer_targets, BUFFER_TARGETS, target);
+    if (generic >= 0)
+        buffers[generic] = buffer;
+    glBindBufferBase(target, index, buffer);
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int index = indexOf(texture_targets, TEXTURE_TARGETS, target);
+    bool shadowed = index >= 0 && unit < (GLuint)TEXTURE_UNITS;
+    if (!changed(TEXTURE, !shadowed || textures[unit][index] != texture))
+        return;
+    if (shadowed)
+        textures[unit][index] = texture;
+    if (active_unit != unit)
+    {
+        active_unit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    glBindTexture(target, texture);
+}
+
+void GLState::setEnabled(GLenum capability, bool enable)
+{
+    int index = indexOf(capabilities, CAPABILITIES, capability);
+    if (!changed(CAPABILITY, index < 0 || enabled[index] != (int)enable))
+        return;
+    if (index >= 0)
+        enabled[index] = enable;
+    if (enable)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+    blendFuncSeparate(source, destination, source, destination);
+}
+
+void GLState::blendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB, GLenum sourceAlpha, GLenum destinationAlpha)
+{
+    const GLenum func[4] = { sourceRGB, destinationRGB, sourceAlpha, destinationAlpha };
+    bool differs = false;
+    for (int i = 0; i < 4; i++)
+        differs |= blend_func[i] != func[i];
+    if (!changed(BLEND, differs))
+        return;
+    for (int i = 0; i < 4; i++)
+        blend_func[i] = func[i];
+    glBlendFuncSeparate(sourceRGB, destinationRGB, sourceAlpha, destinationAlpha);
+}
+
+void GLState::blendEquation(GLenum mode)
+{
+    if (changed(BLEND, blend_equation != mode))
+    {
+        blend_equation = mode;
+        glBlendEquation(mode);
+    }
+}
+
+void GLState::depthFunc(GLenum func)
+{
+    if (changed(DEPTH, depth_func != func))
+    {
+        depth_func = func;
+        glDepthFunc(func);
+    }
+}
+
+void GLState::depthMask(bool write)
+{
+    if (changed(DEPTH, depth_mask != (int)write))
+    {
+        depth_mask = write;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void GLState::cullFace(GLenum mode)
+{
+    if (changed(CULL, cull_face != mode))
+    {
+        cull_face = mode;
+        glCullFace(mode);
+    }
+}
+
+static bool sameRect(const Rect& rect, GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    return rect.known && rect.x == x && rect.y == y && rect.width == width && rect.height == height;
+}
+
+void GLState::scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if (changed(SCISSOR, !sameRect(scissor_box, x, y, width, height)))
+    {
+        scissor_box = Rect{ x, y, width, height, true };
+        glScissor(x, y, width, height);
+    }
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if (changed(VIEWPORT, !sameRect(viewport_rect, x, y, width, height)))
+    {
+        viewport_rect = Rect{ x, y, width, height, true };
+        glViewport(x, y, width, height);
+    }
+}
+
+// GL unbinds a deleted object from the current context, so the shadow
+// does the same and its name can come back with another object.
+void GLState::deleteProgram(GLuint program_)
+{
+    // a program in use stays current until something else is used
+    if (program == program_)
+        program = UNKNOWN;
+    glDeleteProgram(program_);
+}
+
+void GLState::deleteVertexArray(GLuint vao)
+{
+    if (vertex_array == vao)
+    {
+        vertex_array = 0;
+        buffers[indexOf(buffer_targets, BUFFER_TARGETS, GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+    glDeleteVertexArrays(1, &vao);
+}
+
+void GLState::deleteBuffer(GLuint buffer)
+{
+    for (GLuint& bound : buffers)
+    {
+        if (bound == buffer)
+            bound = 0;
+    }
+    for (BufferRange& range : uniform_ranges)
+    {
+        if (range.buffer == buffer)
+            range.buffer = 0;
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void GLState::deleteTexture(GLuint texture)
+{
+    for (auto& unit : textures)
+    {
+        for (GLuint& bound : unit)
+        {
+            if (bound == texture)
+                bound = 0;
+        }
+    }
+    glDeleteTextures(1, &texture);
+}
+
+uint32_t GLState::getIssued(Category category)
+{
+    if (category != CATEGORIES)
+        return last_issued[category].load(std::memory_order_relaxed);
+    uint32_t total = 0;
+    for (const auto& count : last_issued)
+        total += count.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint32_t GLState::getFiltered(Category category)
+{
+    if (category != CATEGORIES)
+        return last_filtered[category].load(std::memory_order_relaxed);
+    uint32_t total = 0;
+    for (const auto& count : last_filtered)
+        total += count.load(std::memory_order_relaxed);
+    return total;
+}
+
+void GLState::drawImGui()
+{
+    ImGui::Columns(3, "gl_state");
+    ImGui::Text("State");
+    ImGui::NextColumn();
+    ImGui::Text("Issued");
+    ImGui::NextColumn();
+    ImGui::Text("Filtered");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (int i = 0; i < CATEGORIES; i++)
+    {
+        ImGui::Text("%s", category_names[i]);
+        ImGui::NextColumn();
+        ImGui::Text("%u", last_issued[i].load(std::memory_order_relaxed));
+        ImGui::NextColumn();
+        ImGui::Text("%u", last_filtered[i].load(std::memory_order_relaxed));
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+}
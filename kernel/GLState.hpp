@@ -0,0 +1,88 @@
+//
+//  GLState.hpp
+//  GameEngine
+//
+
+#ifndef GLState_hpp
+#define GLState_hpp
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <stdint.h>
+
+// Shadow of the GL state the engine changes while drawing. A call that
+// would set what is already set never reaches the driver. Everything
+// starts out unknown, so the first call of each kind always goes through.
+// Code that changes state with raw GL calls has to put it back, like the
+// ImGui backend does, or call invalidate() afterwards.
+// Deleting an object that might be bound must go through the delete
+// functions here, otherwise a reused name could be filtered wrongly.
+// GL thread only.
+class GLState
+{
+public:
+    enum Category
+    {
+        PROGRAM,
+        VERTEX_ARRAY,
+        BUFFER,
+        TEXTURE,
+        CAPABILITY,
+        BLEND,
+        DEPTH,
+        CULL,
+        SCISSOR,
+        VIEWPORT,
+        CATEGORIES
+    };
+    static const int TEXTURE_UNITS = 16;
+    static const int UNIFORM_BINDINGS = 16;
+    
+    // start of a rendered frame, keeps the counts of the last one
+    static void beginFrame();
+    // forget everything, the next calls go to the driver
+    static void invalidate();
+    
+    static void useProgram(GLuint program);
+    // the element buffer belongs to the vertex array and is forgotten with it
+    static void bindVertexArray(GLuint vao);
+    static void bindBuffer(GLenum target, GLuint buffer);
+    // also sets the generic GL_UNIFORM_BUFFER binding, like GL does
+    static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    // activates the unit only when the binding actually changes
+    static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    
+    // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE and GL_SCISSOR_TEST are
+    // shadowed, others pass straight through
+    static void setEnabled(GLenum capability, bool enabled);
+    static void enable(GLenum capability) { setEnabled(capability, true); }
+    static void disable(GLenum capability) { setEnabled(capability, false); }
+    static void blendFunc(GLenum source, GLenum destination);
+    static void blendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB, GLenum sourceAlpha, GLenum destinationAlpha);
+    static void blendEquation(GLenum mode);
+    static void depthFunc(GLenum func);
+    static void depthMask(bool write);
+    static void cullFace(GLenum mode);
+    static void scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+    static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    
+    static void deleteProgram(GLuint program);
+    static void deleteVertexArray(GLuint vao);
+    static void deleteBuffer(GLuint buffer);
+    static void deleteTexture(GLuint texture);
+    
+    // calls of the last frame that reached the driver, and that were dropped.
+    // safe to read from any thread
+    static uint32_t getIssued(Category category = CATEGORIES);
+    static uint32_t getFiltered(Category category = CATEGORIES);
+    // per category table, goes inside an ImGui window
+    static void drawImGui();
+};
+
+#endif /* GLState_hpp */
@@ -0,0 +1,221 @@
+//
+//  GpuProfiler.cpp
+//  GameEngine
+//
+
+#include "GpuProfiler.hpp"
+#include "Profiler.hpp"
+#include "../imgui/imgui.h"
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+struct GpuZone
+{
+    const char* name;
+    int depth;
+    GLuint begin;
+    GLuint end;
+};
+
+struct GpuFrame
+{
+    std::vector<GpuZone> zones;
+    // issued after every other query of the frame, the outer zones end last
+    GLuint last;
+    uint64_t index;
+    bool submitted;
+};
+
+struct GpuResult
+{
+    const char* name;
+    int depth;
+    double ms;
+};
+
+// GL thread state
+static GpuFrame frames[GpuProfiler::LATENCY];
+static int currentFrame = -1;
+static int depth = 0;
+static std::vector<GLuint> freeQueries;
+
+struct ResolvedFrame
+{
+    uint64_t index;
+    std::vector<GpuResult> results;
+};
+
+// results for the ui
+static std::mutex resultLock;
+static std::vector<GpuResult> results;
+static uint64_t droppedFrames = 0;
+// by frame index modulo HISTORY
+static ResolvedFrame history[GpuProfiler::HISTORY];
+// frames below this index are resolved, dropped or were never drawn
+static uint64_t settledFrames = 0;
+
+static GLuint allocQuery()
+{
+    if (freeQueries.empty())
+    {
+        // grow the pool in batches
+        GLuint ids[32];
+        glGenQueries(32, ids);
+        freeQueries.insert(freeQueries.end(), ids, ids + 32);
+    }
+    GLuint id = freeQueries.back();
+    freeQueries.pop_back();
+    return id;
+}
+
+static void recycle(GpuFrame& frame)
+{
+    for (const GpuZone& zone : frame.zones)
+    {
+        freeQueries.push_back(zone.begin);
+        freeQueries.push_back(zone.end);
+    }
+    frame.zones.clear();
+    frame.last = 0;
+    frame.submitted = false;
+}
+
+// Read the frame back if the GPU is done with it, never wait for it.
+static void resolve(GpuFrame& frame)
+{
+    if (!frame.submitted)
+        return;
+    if (frame.zones.empty())
+    {
+        std::lock_guard<std::mutex> guard(resultLock);
+        settledFrames = frame.index + 1;
+        return;
+    }
+    // queries complete in the order they were issued, once the last one is
+    // available reading any of them returns right away
+    GLint available = 0;
+    glGetQueryObjectiv(frame.last, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+        std::lock_guard<std::mutex> guard(resultLock);
+        droppedFrames++;
+        settledFrames = frame.index + 1;
+        return;
+    }
+    
+    std::vector<GpuResult> resolved;
+    for (const GpuZone& zone : frame.zones)
+    {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+        resolved.push_back({zone.name, zone.depth, (end - begin) * 1e-6});
+    }
+    std::lock_guard<std::mutex> guard(resultLock);
+    ResolvedFrame& entry = history[frame.index % GpuProfiler::HISTORY];
+    entry.index = frame.index;
+    entry.results = resolved;
+    results.swap(resolved);
+    settledFrames = frame.index + 1;
+}
+
+void GpuProfiler::beginFrame(uint64_t frameIndex)
+{
+    if (currentFrame >= 0)
+        frames[currentFrame].submitted = true;
+    currentFrame = (currentFrame + 1) % LATENCY;
+    // this slot was filled LATENCY frames ago
+    GpuFrame& frame = frames[currentFrame];
+    resolve(frame);
+    recycle(frame);
+    frame.index = frameIndex;
+    depth = 0;
+}
+
+void GpuProfiler::shutdown()
+{
+    for (GpuFrame& frame : frames)
+        recycle(frame);
+    if (!freeQueries.empty())
+        glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+    freeQueries.clear();
+    currentFrame = -1;
+}
+
+int GpuProfiler::beginZone(const char* name)
+{
+    if (currentFrame < 0)
+        return -1;
+    GpuZone zone;
+    zone.name = name;
+    zone.depth = depth++;
+    zone.begin = allocQuery();
+    zone.end = allocQuery();
+    glQueryCounter(zone.begin, GL_TIMESTAMP);
+    frames[currentFrame].zones.push_back(zone);
+    frames[currentFrame].last = zone.begin;
+    return (int)frames[currentFrame].zones.size() - 1;
+}
+
+void GpuProfiler::endZone(int zone)
+{
+    if (zone < 0)
+        return;
+    depth--;
+    GpuFrame& frame = frames[currentFrame];
+    glQueryCounter(frame.zones[zone].end, GL_TIMESTAMP);
+    frame.last = frame.zones[zone].end;
+}
+
+double GpuProfiler::getTime(const char* name)
+{
+    std::lock_guard<std::mutex> guard(resultLock);
+    for (const GpuResult& result : results)
+        if (strcmp(result.name, name) == 0)
+            return result.ms;
+    return -1.0;
+}
+
+bool GpuProfiler::getFrameTime(uint64_t frameIndex, const char* name, double& ms)
+{
+    ms = -1.0;
+    std::lock_guard<std::mutex> guard(resultLock);
+    if (frameIndex >= settledFrames)
+        return false;
+    const ResolvedFrame& entry = history[frameIndex % HISTORY];
+    if (entry.index != frameIndex)
+        return true;
+    for (const GpuResult& result : entry.results)
+    {
+        if (strcmp(result.name, name) == 0)
+        {
+            ms = result.ms;
+            break;
+        }
+    }
+    return true;
+}
+
+uint64_t GpuProfiler::getDroppedFrames()
+{
+    std::lock_guard<std::mutex> guard(resultLock);
+    return droppedFrames;
+}
+
+void GpuProfiler::drawImGui()
+{
+    std::vector<GpuResult> shown;
+    {
+        std::lock_guard<std::mutex> guard(resultLock);
+        shown = results;
+    }
+    if (shown.empty())
+    {
+        ImGui::TextDisabled("no GPU timings yet");
+        return;
+    }
+    ImGui::Text("%d frame(s) latency, %llu frame(s) dropped", LATENCY, (unsigned long long)getDroppedFrames());
+    for (const GpuResult& result : shown)
+        ImGui::Text("%*s%s  %.3f ms", result.depth * 2, "", result.name, result.ms);
+}
@@ -0,0 +1,66 @@
+//
+//  GpuProfiler.hpp
+//  GameEngine
+//
+
+#ifndef GpuProfiler_hpp
+#define GpuProfiler_hpp
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <stdint.h>
+
+// GPU time per pass from GL_TIMESTAMP queries. Results are read LATENCY
+// frames later and only if they are already available, so measuring never
+// stalls the pipeline. Zones may nest.
+class GpuProfiler
+{
+public:
+    static const int LATENCY = 4;
+    // resolved frames kept for getFrameTime
+    static const int HISTORY = 32;
+    
+    // GL thread: start of frame frameIndex, collects the results of older
+    // frames. indices must increase, gaps are frames that were never drawn
+    static void beginFrame(uint64_t frameIndex);
+    // GL thread: release the query objects, the context must be current
+    static void shutdown();
+    
+    // used by GpuProfileScope, name must be a string literal
+    static int beginZone(const char* name);
+    static void endZone(int zone);
+    
+    // any thread: GPU ms of the zone in the last resolved frame, -1 if unknown
+    static double getTime(const char* name);
+    // any thread: false while frameIndex may still resolve. once it returns
+    // true ms is final, -1 if the frame was dropped, never drawn, had no
+    // such zone or already fell out of the history
+    static bool getFrameTime(uint64_t frameIndex, const char* name, double& ms);
+    // frames whose results were not ready in time and got dropped
+    static uint64_t getDroppedFrames();
+    // per pass table, goes inside an ImGui window
+    static void drawImGui();
+};
+
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(const char* name) { zone = GpuProfiler::beginZone(name); }
+    ~GpuProfileScope() { GpuProfiler::endZone(zone); }
+    
+private:
+    int zone;
+};
+
+#ifndef DISABLE_PROFILER
+#define GPU_PROFILE_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpu_profile_scope_, __LINE__)(name)
+#else
+#define GPU_PROFILE_SCOPE(name)
+#endif
+
+#endif /* GpuProfiler_hpp */
@@ -0,0 +1,110 @@
+//
+//  Input.cpp
+//  GameEngine
+//
+
+#include "Input.hpp"
+#include "Timer.hpp"
+#include <algorithm>
+#include <GLFW/glfw3.h>
+
+Input::Input()
+{
+    dropped = 0;
+    lastDrain = -1;
+    std::fill(keyDown, keyDown + MAX_KEYS, false);
+    std::fill(heldTime, heldTime + MAX_KEYS, 0);
+}
+
+void Input::push(const InputEvent& event)
+{
+    if (!queue.push(event))
+        dropped++;
+}
+
+void Input::pushKey(int key, int action)
+{
+    InputEvent event = {};
+    event.type = KEY_EVENT;
+    event.timestamp = Timer::nowNanos();
+    event.key = key;
+    event.action = action;
+    push(event);
+}
+
+void Input::pushCursor(double xpos, double ypos)
+{
+    InputEvent event = {};
+    event.type = CURSOR_EVENT;
+    event.timestamp = Timer::nowNanos();
+    event.x = xpos;
+    event.y = ypos;
+    push(event);
+}
+
+void Input::pushScroll(double xoffset, double yoffset)
+{
+    InputEvent event = {};
+    event.type = SCROLL_EVENT;
+    event.timestamp = Timer::nowNanos();
+    event.x = xoffset;
+    event.y = yoffset;
+    push(event);
+}
+
+void Input::beginDrain(int64_t until)
+{
+    for (int key : downKeys)
+        heldTime[key] = 0;
+    for (int key : releasedKeys)
+        heldTime[key] = 0;
+    releasedKeys.clear();
+    // first drain, nothing was held before it
+    if (lastDrain < 0)
+        lastDrain = until;
+}
+
+// Credit the time since the last event to every key that is down.
+void Input::advance(int64_t time)
+{
+    if (time <= lastDrain)
+        return;
+    for (int key : downKeys)
+        heldTime[key] += time - lastDrain;
+    lastDrain = time;
+}
+
+void Input::applyKey(const InputEvent& event)
+{
+    if (event.key < 0 || event.key >= MAX_KEYS)
+        return;
+    bool down = event.action != GLFW_RELEASE;
+    if (down == keyDown[event.key])
+        return;
+    keyDown[event.key] = down;
+    if (down)
+        downKeys.push_back(event.key);
+    else
+    {
+        // keep the held time of this drain, it is cleared on the next one
+        downKeys.erase(std::find(downKeys.begin(), downKeys.end(), event.key));
+        releasedKeys.push_back(event.key);
+    }
+}
+
+bool Input::isKeyDown(int key) const
+{
+    return key >= 0 && key < MAX_KEYS && keyDown[key];
+}
+
+double Input::getHeldTime(int key) const
+{
+    if (key < 0 || key >= MAX_KEYS)
+        return 0.0;
+    return heldTime[key] * 1e-9;
+}
+
+uint64_t Input::getDroppedEvents() const
+{
+    return dropped;
+}
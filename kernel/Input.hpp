@@ -0,0 +1,124 @@
+//
+//  Input.hpp
+//  GameEngine
+//
+
+#ifndef Input_hpp
+#define Input_hpp
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "SpscQueue.hpp"
+
+enum InputEventType{
+    KEY_EVENT,
+    CURSOR_EVENT,
+    SCROLL_EVENT
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    // Timer::nowNanos when the event was received
+    int64_t timestamp;
+    // KEY_EVENT
+    int key;
+    int action;
+    // CURSOR_EVENT position, SCROLL_EVENT offset
+    double x;
+    double y;
+};
+
+// Timestamped input events from the GLFW callbacks to the simulation.
+// The callbacks push, the simulation drains the events of each tick and
+// gets the exact time every key was held inside that tick.
+class Input
+{
+public:
+    static const int MAX_KEYS = 512;
+    
+    Input();
+    ~Input() = default;
+    
+    // producer side
+    void pushKey(int key, int action);
+    void pushCursor(double xpos, double ypos);
+    void pushScroll(double xoffset, double yoffset);
+    void push(const InputEvent& event);
+    
+    // consumer side: hand every event up to 'until' to the handler in order,
+    // and integrate held key time from the previous drain up to 'until'
+    template<typename Handler>
+    void drain(int64_t until, Handler&& handler);
+    // only cursor and scroll events up to 'until'. key events are kept for
+    // the next drain, which still sees them at their own time
+    template<typename Handler>
+    void drainLook(int64_t until, Handler&& handler);
+    
+    bool isKeyDown(int key) const;
+    // seconds the key was held during the last drain
+    double getHeldTime(int key) const;
+    uint64_t getDroppedEvents() const;
+    
+private:
+    SpscQueue<InputEvent, 4096> queue;
+    std::atomic<uint64_t> dropped;
+    
+    // consumer state
+    int64_t lastDrain;
+    bool keyDown[MAX_KEYS];
+    int64_t heldTime[MAX_KEYS];
+    std::vector<int> downKeys;
+    std::vector<int> releasedKeys;
+    // key events drainLook took off the queue, older than anything in it
+    std::vector<InputEvent> deferredKeys;
+    
+    void beginDrain(int64_t until);
+    void advance(int64_t time);
+    void applyKey(const InputEvent& event);
+};
+
+template<typename Handler>
+void Input::drain(int64_t until, Handler&& handler)
+{
+    beginDrain(until);
+    size_t deferred = 0;
+    for (; deferred < deferredKeys.size() && deferredKeys[deferred].timestamp <= until; deferred++)
+    {
+        advance(deferredKeys[deferred].timestamp);
+        applyKey(deferredKeys[deferred]);
+        handler(deferredKeys[deferred]);
+    }
+    deferredKeys.erase(deferredKeys.begin(), deferredKeys.begin() + deferred);
+    // whatever is still queued is newer than the keys left over
+    while (deferredKeys.empty())
+    {
+        const InputEvent* event = queue.front();
+        if (!event || event->timestamp > until)
+            break;
+        advance(event->timestamp);
+        if (event->type == KEY_EVENT)
+            applyKey(*event);
+        handler(*event);
+        queue.pop();
+    }
+    advance(until);
+}
+
+template<typename Handler>
+void Input::drainLook(int64_t until, Handler&& handler)
+{
+    while (const InputEvent* event = queue.front())
+    {
+        if (event->timestamp > until)
+            break;
+        if (event->type == KEY_EVENT)
+            deferredKeys.push_back(*event);
+        else
+            handler(*event);
+        queue.pop();
+    }
+}
+
+#endif /* Input_hpp */
@@ -0,0 +1,273 @@
+//
+//  JobSystem.cpp
+//  GameEngine
+//
+
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+
+bool WorkStealingQueue::push(Job* job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= CAPACITY)
+        return false;
+    // release as well as the fence, a thief's acquire load then sees the job's contents
+    jobs[b & (CAPACITY - 1)].store(job, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* WorkStealingQueue::pop()
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b)
+    {
+        // empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+        // last job, race the thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* WorkStealingQueue::steal()
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return nullptr;
+    Job* job = jobs[t & (CAPACITY - 1)].load(std::memory_order_acquire);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+// Jobs are recycled round robin. A slot still in flight is never handed
+// out again, run() executes inline instead when the next one is busy.
+static const uint32_t JOB_POOL_SIZE = 4096;
+
+struct alignas(64) JobThread
+{
+    WorkStealingQueue queue;
+    Job jobs[JOB_POOL_SIZE];
+    uint32_t nextJob = 0;
+    uint32_t nextVictim = 0;
+};
+
+static std::vector<std::unique_ptr<JobThread>> threads;
+static std::vector<std::thread> workers;
+static std::atomic<bool> running(false);
+// jobs sitting in a deque, lets idle workers go to sleep
+static std::atomic<int> pending(0);
+static std::atomic<int> sleeping(0);
+static std::mutex sleep_lock;
+static std::condition_variable sleep_cv;
+static thread_local int thread_index = -1;
+// the profiler keeps the name pointer, so names outlive their workers
+static std::deque<std::string> worker_names;
+
+void JobSystem::init(int workerCount)
+{
+    if (running.load())
+        shutdown();
+    if (workerCount < 0)
+        workerCount = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+    
+    threads.clear();
+    for (int i = 0; i <= workerCount; ++i)
+    {
+        threads.emplace_back(new JobThread());
+        // spread the first steals, everyone starting at thread 0 would collide
+        threads.back()->nextVictim = (uint32_t)(i + 1) % (uint32_t)(workerCount + 1);
+    }
+    
+    thread_index = 0;
+    running.store(true);
+    while ((int)worker_names.size() <= workerCount)
+        worker_names.push_back("Worker " + std::to_string(worker_names.size()));
+    for (int i = 1; i <= workerCount; ++i)
+        workers.emplace_back(workerLoop, i);
+}
+
+void JobSystem::shutdown()
+{
+    if (!running.load())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sleep_lock);
+        running.store(false);
+    }
+    sleep_cv.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    workers.clear();
+    threads.clear();
+    pending.store(0);
+    thread_index = -1;
+}
+
+int JobSystem::getThreadCount()
+{
+    return (int)threads.size();
+}
+
+int JobSystem::getThreadIndex()
+{
+    return thread_index;
+}
+
+Job* JobSystem::allocJob()
+{
+    assert(thread_index >= 0 && "jobs can only be scheduled from the job system threads");
+    JobThread& thread = *threads[thread_index];
+    Job* job = &thread.jobs[thread.nextJob & (JOB_POOL_SIZE - 1)];
+    if (job->active.load(std::memory_order_acquire))
+        return nullptr;
+    thread.nextJob++;
+    job->active.store(true, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::submit(Job* job)
+{
+    if (!threads[thread_index]->queue.push(job))
+    {
+        // deque is full, do it now
+        execute(job);
+        return;
+    }
+    pending.fetch_add(1);
+    if (sleeping.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleep_lock);
+        sleep_cv.notify_one();
+    }
+}
+
+void JobSystem::schedule(Job* job, JobCounter& after)
+{
+    {
+        // the count only reaches zero under this lock, see release()
+        std::lock_guard<std::mutex> lock(after.lock);
+        if (after.count.load(std::memory_order_acquire) != 0)
+        {
+            after.continuations.push_back(job);
+            return;
+        }
+    }
+    submit(job);
+}
+
+bool JobSystem::executeOne()
+{
+    JobThread& self = *threads[thread_index];
+    Job* job = self.queue.pop();
+    if (!job)
+    {
+        // steal, starting where the last successful steal left off
+        int count = (int)threads.size();
+        for (int i = 0; i < count && !job; ++i)
+        {
+            int victim = (int)((self.nextVictim + i) % count);
+            if (victim == thread_index)
+                continue;
+            job = threads[victim]->queue.steal();
+            if (job)
+                self.nextVictim = victim;
+        }
+    }
+    if (!job)
+        return false;
+    pending.fetch_sub(1);
+    execute(job);
+    return true;
+}
+
+void JobSystem::execute(Job* job)
+{
+    job->execute();
+    JobCounter* counter = job->counter;
+    job->active.store(false, std::memory_order_release);
+    if (counter)
+        release(*counter);
+}
+
+void JobSystem::release(JobCounter& counter)
+{
+    int current = counter.count.load(std::memory_order_acquire);
+    while (current > 1)
+    {
+        if (counter.count.compare_exchange_weak(current, current - 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            return;
+    }
+    // Possibly the last one. The count drops to zero under the lock, so a
+    // continuation is either queued before and taken here, or schedule()
+    // sees zero and submits it itself. The counter may be gone as soon as
+    // done() holds, releasing keeps it false until the lock is let go.
+    counter.releasing.fetch_add(1, std::memory_order_relaxed);
+    std::vector<Job*> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter.lock);
+        if (counter.count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            ready.swap(counter.continuations);
+    }
+    counter.releasing.fetch_sub(1, std::memory_order_release);
+    for (Job* next : ready)
+        submit(next);
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    PROFILE_SCOPE("JobSystem::wait");
+    while (!counter.done())
+    {
+        if (!executeOne())
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::workerLoop(int index)
+{
+    thread_index = index;
+    Profiler::setThreadName(worker_names[index].c_str());
+    while (running.load(std::memory_order_relaxed))
+    {
+        if (executeOne())
+            continue;
+        
+        // spin a little before sleeping, a new batch usually follows soon
+        bool found = false;
+        for (int i = 0; i < 64 && !found; ++i)
+        {
+            std::this_thread::yield();
+            found = executeOne();
+        }
+        if (found)
+            continue;
+        
+        std::unique_lock<std::mutex> lock(sleep_lock);
+        sleeping.fetch_add(1);
+        sleep_cv.wait(lock, []{ return pending.load() > 0 || !running.load(); });
+        sleeping.fetch_sub(1);
+    }
+}
@@ -0,0 +1,192 @@
+//
+//  JobSystem.hpp
+//  GameEngine
+//
+
+#ifndef JobSystem_hpp
+#define JobSystem_hpp
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class Job;
+
+// Counts unfinished jobs. Jobs can be scheduled to run once it hits zero.
+class JobCounter
+{
+public:
+    JobCounter() : count(0), releasing(0) {}
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+    
+    bool done() const
+    {
+        return count.load(std::memory_order_acquire) == 0 && releasing.load(std::memory_order_acquire) == 0;
+    }
+    
+private:
+    friend class JobSystem;
+    std::atomic<int> count;
+    // threads still inside release(), the counter must outlive them
+    std::atomic<int> releasing;
+    std::mutex lock;
+    std::vector<Job*> continuations;
+};
+
+// A callable stored inline, so scheduling a job never allocates.
+class Job
+{
+public:
+    static const size_t STORAGE = 48;
+    
+    template<typename F>
+    void set(F&& function)
+    {
+        typedef typename std::decay<F>::type Function;
+        static_assert(sizeof(Function) <= STORAGE, "job captures too much, capture pointers instead");
+        static_assert(std::is_trivially_destructible<Function>::value, "job captures must be trivially destructible");
+        new (storage) Function(std::forward<F>(function));
+        invoke = [](void* callable) { (*static_cast<Function*>(callable))(); };
+    }
+    void execute() { invoke(storage); }
+    
+    JobCounter* counter;
+    // between allocJob and the end of execute, the slot is not reused meanwhile
+    std::atomic<bool> active{ false };
+    
+private:
+    void (*invoke)(void*);
+    alignas(16) unsigned char storage[STORAGE];
+};
+
+// Fixed size Chase-Lev deque. The owning thread pushes and pops at the
+// bottom, other threads steal from the top.
+class WorkStealingQueue
+{
+public:
+    static const int64_t CAPACITY = 4096;
+    
+    WorkStealingQueue() : top(0), bottom(0) {}
+    
+    // owner only, false when full
+    bool push(Job* job);
+    // owner only
+    Job* pop();
+    // any thread
+    Job* steal();
+    
+private:
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    alignas(64) std::atomic<Job*> jobs[CAPACITY];
+};
+
+// Work-stealing job system. The thread calling init is thread 0 and takes
+// part in the work while it waits, every worker owns a deque and steals
+// from the others when it runs dry. Only thread 0 and the workers may
+// schedule jobs.
+class JobSystem
+{
+public:
+    // workers < 0 uses one worker per remaining hardware thread
+    static void init(int workers = -1);
+    static void shutdown();
+    
+    // workers plus the thread that called init
+    static int getThreadCount();
+    // 0 for the init thread, 1..n for workers, -1 for anything else.
+    // meant for indexing per thread data
+    static int getThreadIndex();
+    
+    template<typename F>
+    static void run(F&& function, JobCounter* counter = nullptr);
+    // run the function once 'after' reached zero
+    template<typename F>
+    static void runAfter(JobCounter& after, F&& function, JobCounter* counter = nullptr);
+    // execute other jobs until the counter reaches zero
+    static void wait(JobCounter& counter);
+    
+    // function(begin, end) over [0, count), split into ranges of at most grain
+    template<typename F>
+    static void parallel_for(uint32_t count, uint32_t grain, const F& function);
+    
+private:
+    // null when every job of the calling thread is still in flight
+    static Job* allocJob();
+    static void submit(Job* job);
+    static void schedule(Job* job, JobCounter& after);
+    static bool executeOne();
+    static void execute(Job* job);
+    // one unit of the counter is done, the last one submits its continuations
+    static void release(JobCounter& counter);
+    static void workerLoop(int index);
+    
+    template<typename F>
+    static void splitRange(uint32_t begin, uint32_t end, uint32_t grain, const F* function, JobCounter* counter);
+};
+
+template<typename F>
+void JobSystem::run(F&& function, JobCounter* counter)
+{
+    Job* job = allocJob();
+    if (!job)
+    {
+        // the pool is exhausted, running it right away keeps live jobs intact
+        function();
+        return;
+    }
+    job->set(std::forward<F>(function));
+    job->counter = counter;
+    if (counter)
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+    submit(job);
+}
+
+template<typename F>
+void JobSystem::runAfter(JobCounter& after, F&& function, JobCounter* counter)
+{
+    Job* job = allocJob();
+    if (!job)
+    {
+        wait(after);
+        function();
+        return;
+    }
+    job->set(std::forward<F>(function));
+    job->counter = counter;
+    if (counter)
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+    schedule(job, after);
+}
+
+template<typename F>
+void JobSystem::splitRange(uint32_t begin, uint32_t end, uint32_t grain, const F* function, JobCounter* counter)
+{
+    // hand the upper halves to whoever steals them, keep the lower one
+    while (end - begin > grain)
+    {
+        uint32_t mid = begin + (end - begin) / 2;
+        run([=]{ splitRange(mid, end, grain, function, counter); }, counter);
+        end = mid;
+    }
+    (*function)(begin, end);
+}
+
+template<typename F>
+void JobSystem::parallel_for(uint32_t count, uint32_t grain, const F& function)
+{
+    if (count == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+    JobCounter counter;
+    splitRange(0, count, grain, &function, &counter);
+    wait(counter);
+}
+
+#endif /* JobSystem_hpp */
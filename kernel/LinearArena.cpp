@@ -0,0 +1,67 @@
+//
+//  LinearArena.cpp
+//  GameEngine
+//
+
+#include "LinearArena.hpp"
+#include <stdint.h>
+#include <algorithm>
+#include <new>
+
+static size_t alignUp(uintptr_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+LinearArena::LinearArena(size_t capacity)
+    : block(nullptr), used(0), overflowUsed(0), capacity(capacity), lastUsed(0), highWater(0), growCount(0)
+{
+    if (capacity > 0)
+        block = static_cast<unsigned char*>(::operator new(capacity));
+}
+
+LinearArena::~LinearArena()
+{
+    for (void* chunk : overflow)
+        ::operator delete(chunk);
+    ::operator delete(block);
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+    uintptr_t base = (uintptr_t)block;
+    size_t offset = alignUp(base + used, alignment) - base;
+    if (block && offset + size <= capacity.load(std::memory_order_relaxed))
+    {
+        used = offset + size;
+        return block + offset;
+    }
+    // out of space, this frame pays for a heap block
+    void* chunk = ::operator new(size + alignment);
+    overflow.push_back(chunk);
+    overflowUsed += size + alignment;
+    return (void*)alignUp((uintptr_t)chunk, alignment);
+}
+
+void LinearArena::reset()
+{
+    size_t total = getUsed();
+    lastUsed.store(total, std::memory_order_relaxed);
+    if (total > highWater.load(std::memory_order_relaxed))
+        highWater.store(total, std::memory_order_relaxed);
+    
+    if (!overflow.empty())
+    {
+        for (void* chunk : overflow)
+            ::operator delete(chunk);
+        overflow.clear();
+        // grow with some headroom so a slowly rising load does not regrow every frame
+        size_t grown = std::max(total + total / 2, (size_t)4096);
+        ::operator delete(block);
+        block = static_cast<unsigned char*>(::operator new(grown));
+        capacity.store(grown, std::memory_order_relaxed);
+        growCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    used = 0;
+    overflowUsed = 0;
+}
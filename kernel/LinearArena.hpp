@@ -0,0 +1,77 @@
+//
+//  LinearArena.hpp
+//  GameEngine
+//
+
+#ifndef LinearArena_hpp
+#define LinearArena_hpp
+
+#include <stddef.h>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bump allocator. Allocations are never freed one by one, reset() drops
+// everything at once. When the block runs out the arena falls back to heap
+// overflow blocks and grows to the high-water mark on the next reset, so a
+// steady workload stops touching malloc after a frame or two.
+// Not thread safe, give every thread its own arena.
+class LinearArena
+{
+public:
+    explicit LinearArena(size_t capacity = 0);
+    ~LinearArena();
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+    
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    template<typename T>
+    T* allocate(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+    void reset();
+    
+    // bytes handed out since the last reset, owner thread only
+    size_t getUsed() const { return used + overflowUsed; }
+    // any thread
+    size_t getCapacity() const { return capacity.load(std::memory_order_relaxed); }
+    size_t getLastUsed() const { return lastUsed.load(std::memory_order_relaxed); }
+    size_t getHighWater() const { return highWater.load(std::memory_order_relaxed); }
+    // resets that had to grow the block
+    int getGrowCount() const { return growCount.load(std::memory_order_relaxed); }
+    
+private:
+    unsigned char* block;
+    size_t used;
+    size_t overflowUsed;
+    std::vector<void*> overflow;
+    std::atomic<size_t> capacity;
+    std::atomic<size_t> lastUsed;
+    std::atomic<size_t> highWater;
+    std::atomic<int> growCount;
+};
+
+// STL adapter, deallocate is a no-op. The arena must outlive the container.
+template<typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    
+    ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+    
+    T* allocate(size_t count) { return arena->allocate<T>(count); }
+    void deallocate(T*, size_t) {}
+    
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+    
+    LinearArena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif /* LinearArena_hpp */
@@ -0,0 +1,313 @@
+//
+//  Profiler.cpp
+//  GameEngine
+//
+
+#include "Profiler.hpp"
+#include "GpuProfiler.hpp"
+#include "../imgui/imgui.h"
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+
+// zones kept per thread, a few hundred are recorded per frame
+static const uint64_t ZONE_CAPACITY = 1 << 16;
+
+// One ring entry. Readers run while the owner keeps writing, so every
+// field is atomic and guarded by a sequence number: odd while zone i is
+// being written, 2 * i + 2 once it is complete. A copy is only used when
+// the sequence was the expected one before and after reading it.
+struct ZoneSlot
+{
+    std::atomic<uint64_t> sequence;
+    std::atomic<const char*> name;
+    std::atomic<int64_t> start;
+    std::atomic<int64_t> end;
+    std::atomic<int> depth;
+};
+
+struct ThreadBuffer
+{
+    // may be renamed while the profiler window reads it
+    std::atomic<const char*> name;
+    int id;
+    int depth;
+    // total zones ever written, the writer is the only thread changing it
+    std::atomic<uint64_t> count;
+    ZoneSlot zones[ZONE_CAPACITY];
+};
+
+static std::mutex registryLock;
+static std::vector<std::unique_ptr<ThreadBuffer>> threads;
+static thread_local ThreadBuffer* currentThread = nullptr;
+
+// frame boundaries in ticks, main thread only
+static int64_t previousFrameStart = 0;
+static int64_t currentFrameStart = 0;
+
+// what the ui shows, a copy so it can be paused
+struct ShownZone
+{
+    ProfileZone zone;
+    int thread;
+};
+static bool paused = false;
+static int64_t shownStart = 0;
+static int64_t shownEnd = 0;
+static std::vector<ShownZone> shownZones;
+
+static ThreadBuffer* threadBuffer()
+{
+    if (!currentThread)
+    {
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+        buffer->name = "Thread";
+        buffer->depth = 0;
+        buffer->count = 0;
+        std::lock_guard<std::mutex> guard(registryLock);
+        buffer->id = (int)threads.size();
+        currentThread = buffer.get();
+        // buffers outlive their threads so zones can still be exported
+        threads.push_back(std::move(buffer));
+    }
+    return currentThread;
+}
+
+void Profiler::setThreadName(const char* name)
+{
+    threadBuffer()->name.store(name, std::memory_order_relaxed);
+}
+
+void Profiler::beginFrame()
+{
+    previousFrameStart = currentFrameStart;
+    currentFrameStart = Timer::ticks();
+}
+
+int Profiler::enterZone()
+{
+    return threadBuffer()->depth++;
+}
+
+void Profiler::leaveZone(const char* name, int64_t start, int depth)
+{
+    ThreadBuffer* buffer = currentThread;
+    buffer->depth = depth;
+    uint64_t index = buffer->count.load(std::memory_order_relaxed);
+    ZoneSlot& slot = buffer->zones[index & (ZONE_CAPACITY - 1)];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(Timer::ticks(), std::memory_order_relaxed);
+    slot.depth.store(depth, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+// Copy zone index of the buffer, false if it is being written or was
+// already overwritten by a newer one.
+static bool readZone(const ThreadBuffer& buffer, uint64_t index, ProfileZone& zone)
+{
+    const ZoneSlot& slot = buffer.zones[index & (ZONE_CAPACITY - 1)];
+    uint64_t expected = 2 * index + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != expected)
+        return false;
+    zone.name = slot.name.load(std::memory_order_relaxed);
+    zone.start = slot.start.load(std::memory_order_relaxed);
+    zone.end = slot.end.load(std::memory_order_relaxed);
+    zone.depth = slot.depth.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == expected;
+}
+
+// Copy the zones of [start, end) from every thread.
+static void collectZones(int64_t start, int64_t end)
+{
+    shownStart = start;
+    shownEnd = end;
+    shownZones.clear();
+    std::lock_guard<std::mutex> guard(registryLock);
+    for (auto& buffer : threads)
+    {
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        uint64_t oldest = count > ZONE_CAPACITY ? count - ZONE_CAPACITY : 0;
+        // zones are written in the order they end
+        for (uint64_t i = count; i > oldest; i--)
+        {
+            ProfileZone zone;
+            if (!readZone(*buffer, i - 1, zone))
+                continue;
+            if (zone.end < start)
+                break;
+            if (zone.start >= end)
+                continue;
+            shownZones.push_back({zone, buffer->id});
+        }
+    }
+}
+
+static ImU32 zoneColor(const char* name)
+{
+    // names are literals, the pointer is a stable identity
+    uint32_t hash = (uint32_t)((uintptr_t)name * 2654435761u);
+    return ImColor::HSV((hash % 360) / 360.0f, 0.55f, 0.65f);
+}
+
+void Profiler::drawImGui()
+{
+    ImGui::Checkbox("Pause", &paused);
+    ImGui::SameLine();
+    if (ImGui::Button("Export Chrome trace"))
+        exportChromeTrace("profile.json");
+    
+    if (!paused && previousFrameStart != 0)
+        collectZones(previousFrameStart, currentFrameStart);
+    if (shownEnd <= shownStart)
+        return;
+    
+    const double period = Timer::tickPeriod();
+    double frameTime = (shownEnd - shownStart) * period * 1e-6;
+    ImGui::Text("Frame %.3f ms, %d zones", frameTime, (int)shownZones.size());
+    
+    // one lane per thread, one row per nesting level
+    const float width = ImGui::GetContentRegionAvail().x;
+    const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    const float scale = width / (float)(shownEnd - shownStart);
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    
+    std::vector<const char*> names;
+    {
+        std::lock_guard<std::mutex> guard(registryLock);
+        for (auto& buffer : threads)
+            names.push_back(buffer->name.load(std::memory_order_relaxed));
+    }
+    for (int thread = 0; thread < (int)names.size(); thread++)
+    {
+        int rows = 0;
+        for (const ShownZone& shown : shownZones)
+            if (shown.thread == thread && shown.zone.depth + 1 > rows)
+                rows = shown.zone.depth + 1;
+        if (rows == 0)
+            continue;
+        
+        ImGui::TextDisabled("%s", names[thread]);
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        for (const ShownZone& shown : shownZones)
+        {
+            if (shown.thread != thread)
+                continue;
+            const ProfileZone& zone = shown.zone;
+            float x0 = origin.x + (zone.start > shownStart ? zone.start - shownStart : 0) * scale;
+            float x1 = origin.x + (zone.end < shownEnd ? zone.end - shownStart : shownEnd - shownStart) * scale;
+            if (x1 - x0 < 1.0f)
+                x1 = x0 + 1.0f;
+            ImVec2 a(x0, origin.y + zone.depth * rowHeight);
+            ImVec2 b(x1, a.y + rowHeight - 1.0f);
+            draw->AddRectFilled(a, b, zoneColor(zone.name));
+            if (x1 - x0 > 20.0f)
+            {
+                draw->PushClipRect(a, b, true);
+                draw->AddText(ImVec2(a.x + 2.0f, a.y), IM_COL32_WHITE, zone.name);
+                draw->PopClipRect();
+            }
+            if (ImGui::IsMouseHoveringRect(a, b))
+                ImGui::SetTooltip("%s\n%.3f ms", zone.name, (zone.end - zone.start) * period * 1e-6);
+        }
+        ImGui::Dummy(ImVec2(width, rows * rowHeight));
+    }
+    
+    // totals per zone name
+    struct Total { const char* name; int calls; int64_t time; };
+    std::vector<Total> totals;
+    for (const ShownZone& shown : shownZones)
+    {
+        Total* total = nullptr;
+        for (Total& t : totals)
+            if (t.name == shown.zone.name)
+                total = &t;
+        if (!total)
+        {
+            totals.push_back({shown.zone.name, 0, 0});
+            total = &totals.back();
+        }
+        total->calls++;
+        total->time += shown.zone.end - shown.zone.start;
+    }
+    ImGui::Columns(4, "profiler_totals");
+    ImGui::Text("Zone"); ImGui::NextColumn();
+    ImGui::Text("Calls"); ImGui::NextColumn();
+    ImGui::Text("CPU ms"); ImGui::NextColumn();
+    ImGui::Text("GPU ms"); ImGui::NextColumn();
+    for (const Total& total : totals)
+    {
+        ImGui::Text("%s", total.name); ImGui::NextColumn();
+        ImGui::Text("%d", total.calls); ImGui::NextColumn();
+        ImGui::Text("%.3f", total.time * period * 1e-6); ImGui::NextColumn();
+        // passes wrapped in a GPU_PROFILE_SCOPE of the same name
+        double gpu = GpuProfiler::getTime(total.name);
+        if (gpu >= 0.0)
+            ImGui::Text("%.3f", gpu);
+        else
+            ImGui::TextDisabled("-");
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+}
+
+static void writeJsonString(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const char* c = text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+bool Profiler::exportChromeTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to write profile to %s\n", path);
+        return false;
+    }
+    
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    const double period = Timer::tickPeriod();
+    std::lock_guard<std::mutex> guard(registryLock);
+    for (auto& buffer : threads)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", buffer->id);
+        writeJsonString(file, buffer->name.load(std::memory_order_relaxed));
+        fprintf(file, "}}");
+        first = false;
+        
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        uint64_t oldest = count > ZONE_CAPACITY ? count - ZONE_CAPACITY : 0;
+        for (uint64_t i = oldest; i < count; i++)
+        {
+            // the oldest ones are overwritten while we go, those are dropped
+            ProfileZone zone;
+            if (!readZone(*buffer, i, zone))
+                continue;
+            // timestamps are in microseconds
+            int64_t start = Timer::ticksToNanos(zone.start, period);
+            int64_t end = Timer::ticksToNanos(zone.end, period);
+            fprintf(file, ",\n{\"name\":");
+            writeJsonString(file, zone.name);
+            fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    buffer->id, start * 1e-3, (end - start) * 1e-3);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    printf("Profile written to %s\n", path);
+    return true;
+}
@@ -0,0 +1,70 @@
+//
+//  Profiler.hpp
+//  GameEngine
+//
+
+#ifndef Profiler_hpp
+#define Profiler_hpp
+
+#include <stdint.h>
+#include "Timer.hpp"
+
+// A finished zone. name must be a string literal, only the pointer is kept.
+// start and end are Timer::ticks, see Timer::ticksToNanos.
+struct ProfileZone
+{
+    const char* name;
+    int64_t start;
+    int64_t end;
+    int depth;
+};
+
+// Low overhead CPU profiler. Every thread records finished zones into its
+// own ring buffer without locks, the ui and the exporter read them from
+// the main thread.
+class Profiler
+{
+public:
+    // name shown for the calling thread, must outlive the profiler
+    static void setThreadName(const char* name);
+    // main thread, marks the start of a new frame
+    static void beginFrame();
+    
+    // used by ProfileScope
+    static int enterZone();
+    static void leaveZone(const char* name, int64_t start, int depth);
+    
+    // timeline of the last frame, goes inside an ImGui window
+    static void drawImGui();
+    // everything still in the ring buffers, in chrome://tracing format
+    static bool exportChromeTrace(const char* path);
+};
+
+class ProfileScope
+{
+public:
+    ProfileScope(const char* name) : name(name)
+    {
+        depth = Profiler::enterZone();
+        start = Timer::ticks();
+    }
+    ~ProfileScope()
+    {
+        Profiler::leaveZone(name, start, depth);
+    }
+    
+private:
+    const char* name;
+    int64_t start;
+    int depth;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifndef DISABLE_PROFILER
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+#endif /* Profiler_hpp */
@@ -0,0 +1,234 @@
+//
+//  ProgramCache.cpp
+//  GameEngine
+//
+
+#include "ProgramCache.hpp"
+#include <stdio.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+// file layout: header, then the driver's binary blob
+struct CacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+    uint64_t checksum;
+};
+static const char CACHE_MAGIC[4] = { 'G', 'E', 'P', 'B' };
+static const uint32_t CACHE_VERSION = 1;
+
+static std::string cache_directory = "shader_cache";
+static bool cache_enabled = true;
+static int cache_hits = 0;
+static int cache_misses = 0;
+static int cache_rejected = 0;
+static std::mutex cache_lock;
+
+void ProgramCache::setDirectory(const std::string& directory)
+{
+    cache_directory = directory;
+}
+
+void ProgramCache::setEnabled(bool enabled)
+{
+    cache_enabled = enabled;
+}
+
+bool ProgramCache::isAvailable()
+{
+    if (!cache_enabled)
+        return false;
+    // there is one context, ask once
+    static GLint formats = -1;
+    if (formats < 0)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+uint64_t ProgramCache::hash(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t value = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        value ^= bytes[i];
+        value *= 1099511628211ull;
+    }
+    return value;
+}
+
+static uint64_t hashString(const char* text, uint64_t seed)
+{
+    if (!text)
+        text = "";
+    // include the terminator so "ab"+"c" and "a"+"bc" differ
+    return ProgramCache::hash(text, strlen(text) + 1, seed);
+}
+
+uint64_t ProgramCache::makeKey(const std::vector<std::string>& sources, const std::vector<GLenum>& stages)
+{
+    uint64_t key = hash(&CACHE_VERSION, sizeof(CACHE_VERSION));
+    key = hashString((const char*)glGetString(GL_VENDOR), key);
+    key = hashString((const char*)glGetString(GL_RENDERER), key);
+    key = hashString((const char*)glGetString(GL_VERSION), key);
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        GLenum stage = i < stages.size() ? stages[i] : 0;
+        key = hash(&stage, sizeof(stage), key);
+        key = hashString(sources[i].c_str(), key);
+    }
+    return key;
+}
+
+static std::string entryPath(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return cache_directory + "/" + name;
+}
+
+static void countResult(int& counter)
+{
+    std::lock_guard<std::mutex> guard(cache_lock);
+    counter++;
+}
+
+GLuint ProgramCache::load(uint64_t key)
+{
+    if (!isAvailable())
+        return 0;
+    std::string path = entryPath(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        countResult(cache_misses);
+        return 0;
+    }
+    
+    CacheHeader header;
+    std::vector<char> binary;
+    bool valid = (bool)file.read((char*)&header, sizeof(header))
+        && memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+        && header.version == CACHE_VERSION
+        && header.key == key;
+    if (valid)
+    {
+        // the entry is the header and the binary, nothing else. a length
+        // that disagrees with the file is corruption, not an allocation size
+        std::streamoff offset = file.tellg();
+        file.seekg(0, std::ios::end);
+        std::streamoff remaining = (std::streamoff)file.tellg() - offset;
+        file.seekg(offset);
+        valid = header.length > 0 && (std::streamoff)header.length == remaining;
+    }
+    if (valid)
+    {
+        binary.resize(header.length);
+        valid = (bool)file.read(binary.data(), header.length)
+            && hash(binary.data(), binary.size()) == header.checksum;
+    }
+    file.close();
+    
+    GLuint program = 0;
+    if (valid)
+    {
+        program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            // the driver refused it, e.g. it changed without changing its version string
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    if (!program)
+    {
+        remove(path.c_str());
+        countResult(cache_rejected);
+        countResult(cache_misses);
+        return 0;
+    }
+    countResult(cache_hits);
+    return program;
+}
+
+void ProgramCache::store(uint64_t key, GLuint program)
+{
+    if (!isAvailable() || program == 0)
+        return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.key = key;
+    std::vector<char> binary(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+    header.format = format;
+    header.length = (uint32_t)written;
+    header.checksum = hash(binary.data(), (size_t)written);
+    
+    mkdir(cache_directory.c_str(), 0755);
+    // write next to the entry and rename, a crash never leaves half a file
+    std::string path = entryPath(key);
+    std::string temporary = path + ".tmp";
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cerr << "Program cache: cannot write " << temporary << std::endl;
+        return;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write(binary.data(), written);
+    file.close();
+    if (!file || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "Program cache: cannot write " << path << std::endl;
+        remove(temporary.c_str());
+    }
+}
+
+int ProgramCache::getHits()
+{
+    std::lock_guard<std::mutex> guard(cache_lock);
+    return cache_hits;
+}
+
+int ProgramCache::getMisses()
+{
+    std::lock_guard<std::mutex> guard(cache_lock);
+    return cache_misses;
+}
+
+int ProgramCache::getRejected()
+{
+    std::lock_guard<std::mutex> guard(cache_lock);
+    return cache_rejected;
+}
+
+void ProgramCache::report()
+{
+    if (!cache_enabled)
+    {
+        printf("Program cache: disabled\n");
+        return;
+    }
+    printf("Program cache: %d hit(s), %d miss(es), %d stale entr%s dropped\n",
+           getHits(), getMisses(), getRejected(), getRejected() == 1 ? "y" : "ies");
+}
@@ -0,0 +1,52 @@
+//
+//  ProgramCache.hpp
+//  GameEngine
+//
+
+#ifndef ProgramCache_hpp
+#define ProgramCache_hpp
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked program binaries. Entries are keyed by the
+// shader sources and the driver's vendor, renderer and version, so a
+// driver update or an edited shader simply misses. Anything that does not
+// load cleanly is deleted and compiled from source again.
+class ProgramCache
+{
+public:
+    // default "shader_cache" next to the working directory
+    static void setDirectory(const std::string& directory);
+    static void setEnabled(bool enabled);
+    // false when disabled or the driver offers no binary formats
+    static bool isAvailable();
+    
+    // GL thread. stages are the GLenum shader types, one per source
+    static uint64_t makeKey(const std::vector<std::string>& sources, const std::vector<GLenum>& stages);
+    // a linked program, or 0 on a miss
+    static GLuint load(uint64_t key);
+    // call on a freshly linked program that was created with
+    // GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    static void store(uint64_t key, GLuint program);
+    
+    static int getHits();
+    static int getMisses();
+    // entries that existed but were stale or corrupt
+    static int getRejected();
+    // one line summary on stdout
+    static void report();
+    
+    // FNV-1a, also used for the key
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+};
+
+#endif /* ProgramCache_hpp */
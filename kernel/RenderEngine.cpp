@@ -8,22 +8,227 @@
 
 #include "RenderEngine.hpp"
 #include "Camera.hpp"
+#include "Frustum.hpp"
+#include "FrameAllocator.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <new>
 
-RenderEngine::RenderEngine()
+RenderEngine::RenderEngine() : drawCalls(0), programChanges(0), materialChanges(0), vertexArrayChanges(0)
 {
     // initalize all object here
+    lodDistances[0] = 50.0f;
+    lodDistances[1] = 150.0f;
+    lodDistances[2] = 400.0f;
 }
 
 void RenderEngine::init()
 {
     // initialize all program here
 }
-void RenderEngine::render(float elapsedTime)
+void RenderEngine::prepare(FramePacket& frame)
 {
-    
+    PROFILE_SCOPE("RenderEngine::prepare");
+    transforms.update(frame.frameIndex);
+    frame.worldMatrices = transforms.getWorldMatrices();
+    cullViews(frame);
+    queueDraws(frame);
 }
 
-void RenderEngine::update()
+// One traversal for every view: each chunk of objects is culled against
+// all views while it is still in cache and the lod is picked once. Views
+// only set their bit in a per object mask, the per view index lists are
+// filled from the masks in a second sweep that reads nothing else.
+void RenderEngine::cullViews(FramePacket& frame)
 {
+    PROFILE_SCOPE("Cull views");
+    SphereArrays world = transforms.getWorldSpheres();
+    const uint32_t* layers = transforms.getLayers();
+    uint32_t count = world.count;
+    LinearArena& arena = FrameAllocator::get();
+    uint32_t* masks = arena.allocate<uint32_t>(count);
+    uint8_t* lods = arena.allocate<uint8_t>(count);
+    frame.lods = lods;
+    frame.objectCount = count;
+    
+    int viewCount = frame.viewCount;
+    Frustum frustums[ViewRegistry::MAX_VIEWS];
+    uint32_t viewLayers[ViewRegistry::MAX_VIEWS];
+    bool filterLayers = false;
+    for (int v = 0; v < viewCount; v++)
+    {
+        frustums[v] = Frustum(frame.views[v].viewProjection);
+        viewLayers[v] = frame.views[v].layerMask;
+        filterLayers |= viewLayers[v] != ViewRegistry::ALL_LAYERS;
+    }
+    const glm::vec3 eye = frame.mainView().position;
+    
+    JobSystem::parallel_for(count, 4096, [&](uint32_t begin, uint32_t end) {
+        SphereArrays spheres = { world.x + begin, world.y + begin, world.z + begin,
+                                 world.radius + begin, end - begin };
+        uint32_t* chunkMasks = masks + begin;
+        std::fill(chunkMasks, chunkMasks + (end - begin), 0u);
+        for (int v = 0; v < viewCount; v++)
+            frustums[v].markSpheres(spheres, 1u << v, chunkMasks);
+        
+        for (uint32_t i = begin; i < end; i++)
+        {
+            if (filterLayers)
+            {
+                uint32_t allowed = 0;
+                for (int v = 0; v < viewCount; v++)
+                    allowed |= (layers[i] & viewLayers[v]) ? 1u << v : 0u;
+                masks[i] &= allowed;
+            }
+            // only visible objects need a lod
+            if (masks[i] == 0)
+                continue;
+            float dx = world.x[i] - eye.x;
+            float dy = world.y[i] - eye.y;
+            float dz = world.z[i] - eye.z;
+            float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - world.radius[i];
+            uint8_t lod = 0;
+            while (lod < MAX_LODS - 1 && distance > lodDistances[lod])
+                lod++;
+            lods[i] = lod;
+        }
+    });
     
+    uint32_t* visible[ViewRegistry::MAX_VIEWS];
+    uint32_t visibleCount[ViewRegistry::MAX_VIEWS];
+    for (int v = 0; v < viewCount; v++)
+    {
+        visible[v] = arena.allocate<uint32_t>(count);
+        visibleCount[v] = 0;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (uint32_t mask = masks[i]; mask; mask &= mask - 1)
+        {
+            int v = __builtin_ctz(mask);
+            visible[v][visibleCount[v]++] = i;
+        }
+    }
+    for (int v = 0; v < viewCount; v++)
+    {
+        frame.views[v].visible = visible[v];
+        frame.views[v].visibleCount = visibleCount[v];
+    }
+}
+
+// Visible objects of every view that have something to draw, with the
+// mesh of their lod, keyed by their depth along that view's direction and
+// sorted right away, so the render thread only walks the queues.
+void RenderEngine::queueDraws(FramePacket& frame)
+{
+    PROFILE_SCOPE("Queue draws");
+    LinearArena& arena = FrameAllocator::get();
+    SphereArrays world = transforms.getWorldSpheres();
+    for (int v = 0; v < frame.viewCount; v++)
+    {
+        FrameView& view = frame.views[v];
+        RenderQueue* queue = new (arena.allocate<RenderQueue>(1)) RenderQueue(arena, view.visibleCount);
+        view.queue = queue;
+        
+        // third row of the view matrix, view space z is negative in front
+        const glm::mat4& m = view.view;
+        for (uint32_t i = 0; i < view.visibleCount; i++)
+        {
+            uint32_t slot = view.visible[i];
+            uint32_t node = transforms.getNode(slot);
+            if (node >= materials.size() || !materials[node])
+                continue;
+            float depth = -(m[0][2] * world.x[slot] + m[1][2] * world.y[slot] + m[2][2] * world.z[slot] + m[3][2]);
+            DrawItem item = { materials[node], meshes[node * MAX_LODS + frame.lods[slot]], 1, slot };
+            queue->push(item, depth);
+        }
+        queue->sort();
+    }
+}
+
+// Only the main view has a target yet, the default framebuffer. The queues
+// of the other views wait in the packet for the passes that own theirs.
+void RenderEngine::render(const FramePacket& frame)
+{
+    PROFILE_SCOPE("RenderEngine::render");
+    RenderStats stats = {};
+    if (frame.viewCount > 0 && frame.mainView().queue)
+        stats = frame.mainView().queue->draw(frame.worldMatrices);
+    drawCalls = stats.drawCalls;
+    programChanges = stats.programs;
+    materialChanges = stats.materials;
+    vertexArrayChanges = stats.vertexArrays;
+}
+
+void RenderEngine::update(float deltaTime)
+{
+    PROFILE_SCOPE("RenderEngine::update");
+    {
+        PROFILE_SCOPE("Motion");
+        // whole chunks per job, the loop runs over plain arrays
+        world.view<Position, Velocity>().parallelEachChunk(
+            [deltaTime](uint32_t count, const Entity*, Position* positions, Velocity* velocities) {
+                for (uint32_t i = 0; i < count; i++)
+                    positions[i].value += velocities[i].value * deltaTime;
+            });
+    }
+}
+
+uint32_t RenderEngine::addObject(const glm::vec3& center, float radius, uint32_t layerMask)
+{
+    uint32_t object = transforms.create();
+    // the node may be a recycled one
+    if (object < materials.size())
+        materials[object] = nullptr;
+    transforms.setPosition(object, center);
+    transforms.setBoundingRadius(object, radius);
+    transforms.setLayers(object, layerMask);
+    return object;
+}
+
+void RenderEngine::setObjectBounds(uint32_t object, const glm::vec3& center, float radius)
+{
+    transforms.setPosition(object, center);
+    transforms.setBoundingRadius(object, radius);
+}
+
+uint32_t RenderEngine::getObjectCount() const
+{
+    return transforms.getCount();
+}
+
+void RenderEngine::setObjectMesh(uint32_t object, const Mesh& mesh, const Material* material)
+{
+    if (object >= materials.size())
+    {
+        meshes.resize((object + 1) * MAX_LODS, Mesh());
+        materials.resize(object + 1, nullptr);
+    }
+    std::fill(meshes.begin() + object * MAX_LODS, meshes.begin() + (object + 1) * MAX_LODS, mesh);
+    materials[object] = material;
+}
+
+void RenderEngine::setObjectLodMesh(uint32_t object, int lod, const Mesh& mesh)
+{
+    if (object >= materials.size() || lod < 0 || lod >= MAX_LODS)
+        return;
+    meshes[object * MAX_LODS + lod] = mesh;
+}
+
+RenderStats RenderEngine::getRenderStats() const
+{
+    RenderStats stats;
+    stats.drawCalls = drawCalls.load(std::memory_order_relaxed);
+    stats.programs = programChanges.load(std::memory_order_relaxed);
+    stats.materials = materialChanges.load(std::memory_order_relaxed);
+    stats.vertexArrays = vertexArrayChanges.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void RenderEngine::setLodDistances(const float distances[MAX_LODS - 1])
+{
+    for (int i = 0; i < MAX_LODS - 1; i++)
+        lodDistances[i] = distances[i];
 }
@@ -9,17 +9,79 @@
 #ifndef RenderEngine_hpp
 #define RenderEngine_hpp
 
+#include "FramePacket.hpp"
+#include "RenderQueue.hpp"
+#include "TransformHierarchy.hpp"
+#include "World.hpp"
+#include <glm/glm.hpp>
+#include <atomic>
+#include <vector>
+
+// Components the engine's own systems run on.
+struct Position
+{
+    glm::vec3 value;
+};
+
+struct Velocity
+{
+    glm::vec3 value;
+};
+
 class RenderEngine
 {
 public:
+    static const int MAX_LODS = 4;
+    
     RenderEngine();
     ~RenderEngine() = default;
     
     void init();
-    void render(float elapsedTime);
-    void update();
+    // main thread: record what render() needs into the packet. All views
+    // are culled in one pass, per object work is done once and shared.
+    void prepare(FramePacket& frame);
+    // render thread: only reads the packet, frame.alpha is how far the
+    // frame lies between the last two simulation ticks
+    void render(const FramePacket& frame);
+    // main thread, may fan work out with JobSystem::parallel_for
+    void update(float deltaTime);
+    
+    // entities the systems in update() iterate
+    World& getWorld() { return world; }
+    
+    // render objects are transform nodes, drawn into views sharing a layer
+    // bit. The bounding sphere sits at the node's origin
+    uint32_t addObject(const glm::vec3& center, float radius, uint32_t layerMask = 1);
+    void setObjectBounds(uint32_t object, const glm::vec3& center, float radius);
+    uint32_t getObjectCount() const;
+    // parenting and local transforms of the objects
+    TransformHierarchy& getTransforms() { return transforms; }
+    // what the object is drawn with, no material to not draw it. Sets the
+    // mesh of every lod
+    void setObjectMesh(uint32_t object, const Mesh& mesh, const Material* material);
+    // replaces the mesh of one lod, after setObjectMesh
+    void setObjectLodMesh(uint32_t object, int lod, const Mesh& mesh);
+    // of the last rendered frame, any thread
+    RenderStats getRenderStats() const;
+    // distance from the main view where each lod after the first starts
+    void setLodDistances(const float distances[MAX_LODS - 1]);
+    
 private:
+    // world bounding spheres come out as structure of arrays for the SIMD
+    // culling kernels
+    TransformHierarchy transforms;
+    // by transform node, MAX_LODS meshes per node
+    std::vector<Mesh> meshes;
+    std::vector<const Material*> materials;
+    float lodDistances[MAX_LODS - 1];
+    World world;
+    std::atomic<uint32_t> drawCalls;
+    std::atomic<uint32_t> programChanges;
+    std::atomic<uint32_t> materialChanges;
+    std::atomic<uint32_t> vertexArrayChanges;
     
+    void cullViews(FramePacket& frame);
+    void queueDraws(FramePacket& frame);
 };
 
 #endif /* RenderEngine_hpp */
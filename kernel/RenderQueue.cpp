@@ -0,0 +1,189 @@
+//
+//  RenderQueue.cpp
+//  GameEngine
+//
+
+#include "RenderQueue.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+#include <atomic>
+#include <cstring>
+
+static const int PROGRAM_BITS = 12;
+static const int MATERIAL_BITS = 16;
+static const int DEPTH_BITS = 24;
+static const int LAYER_SHIFT = 60;
+static const int TRANSLUCENT_SHIFT = 59;
+
+static std::atomic<uint32_t> next_material_id(0);
+
+Material::Material() : program(nullptr), textureCount(0), translucent(false), doubleSided(false), layer(0)
+{
+    for (int i = 0; i < MAX_TEXTURES; i++)
+    {
+        textures[i] = 0;
+        textureTargets[i] = GL_TEXTURE_2D;
+    }
+    id = next_material_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+RenderQueue::RenderQueue(LinearArena& arena_, uint32_t capacity_) : arena(&arena_), count(0), capacity(capacity_ > 0 ? capacity_ : 64)
+{
+    items = arena->allocate<DrawItem>(capacity);
+    entries = arena->allocate<Entry>(capacity);
+}
+
+uint64_t RenderQueue::makeKey(const Material& material, float depth)
+{
+    // the bits of a positive float sort like the float, the top ones are
+    // a logarithmic depth bucket that needs no range
+    if (!(depth > 0.0f))
+        depth = 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    uint64_t bucket = (bits >> (31 - DEPTH_BITS)) & ((1u << DEPTH_BITS) - 1);
+    // not the GL name, the render thread swaps that in on every rebuild
+    uint64_t program = material.program ? material.program->getSortId() & ((1u << PROGRAM_BITS) - 1) : 0;
+    uint64_t id = material.id & ((1u << MATERIAL_BITS) - 1);
+    uint64_t key = (uint64_t)(material.layer & (LAYERS - 1)) << LAYER_SHIFT;
+    if (!material.translucent)
+        return key | program << 47 | id << 31 | bucket << 7;
+    bucket = ~bucket & ((1u << DEPTH_BITS) - 1);
+    return key | (uint64_t)1 << TRANSLUCENT_SHIFT | bucket << 35 | program << 23 | id << 7;
+}
+
+void RenderQueue::push(const DrawItem& item, float depth)
+{
+    if (!item.material || !item.material->program)
+        return;
+    if (count == capacity)
+    {
+        // the old arrays stay behind in the arena until the frame is recycled
+        capacity *= 2;
+        DrawItem* grownItems = arena->allocate<DrawItem>(capacity);
+        Entry* grownEntries = arena->allocate<Entry>(capacity);
+        memcpy(grownItems, items, count * sizeof(DrawItem));
+        memcpy(grownEntries, entries, count * sizeof(Entry));
+        items = grownItems;
+        entries = grownEntries;
+    }
+    items[count] = item;
+    entries[count].key = makeKey(*item.material, depth);
+    entries[count].item = count;
+    count++;
+}
+
+// Least significant byte first, one pass per byte. All histograms are
+// built in one read, bytes every key shares are skipped, which with few
+// programs and materials is most of them.
+void RenderQueue::sort()
+{
+    PROFILE_SCOPE("RenderQueue::sort");
+    if (count < 2)
+        return;
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint64_t key = entries[i].key;
+        for (int pass = 0; pass < 8; pass++)
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+    }
+    
+    Entry* source = entries;
+    Entry* target = nullptr;
+    for (int pass = 0; pass < 8; pass++)
+    {
+        uint32_t* histogram = histograms[pass];
+        if (histogram[(source[0].key >> (pass * 8)) & 0xFF] == count)
+            continue;
+        if (!target)
+            target = arena->allocate<Entry>(capacity);
+        uint32_t offset = 0;
+        for (int digit = 0; digit < 256; digit++)
+        {
+            uint32_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (uint32_t i = 0; i < count; i++)
+            target[histogram[(source[i].key >> (pass * 8)) & 0xFF]++] = source[i];
+        Entry* swap = source;
+        source = target;
+        target = swap;
+    }
+    // the scratch array is the arena's as well, keep whichever holds the result
+    entries = source;
+}
+
+RenderStats RenderQueue::draw(const glm::mat4* worldMatrices) const
+{
+    PROFILE_SCOPE("RenderQueue::draw");
+    RenderStats stats = {};
+    const Material* current = nullptr;
+    GLuint vertexArray = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const DrawItem& item = items[entries[i].item];
+        const Material* material = item.material;
+        if (material != current)
+        {
+            if (!current || material->program != current->program)
+            {
+                material->program->use();
+                stats.programs++;
+            }
+            if (!current || material->translucent != current->translucent)
+            {
+                GLState::setEnabled(GL_BLEND, material->translucent);
+                if (material->translucent)
+                    GLState::blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+                GLState::depthMask(!material->translucent);
+            }
+            if (!current || material->doubleSided != current->doubleSided)
+                GLState::setEnabled(GL_CULL_FACE, !material->doubleSided);
+            for (int unit = 0; unit < material->textureCount; unit++)
+            {
+                if (!current || unit >= current->textureCount || material->textures[unit] != current->textures[unit] ||
+                    material->textureTargets[unit] != current->textureTargets[unit])
+                    GLState::bindTexture(unit, material->textureTargets[unit], material->textures[unit]);
+            }
+            stats.materials++;
+            current = material;
+        }
+        if (stats.drawCalls == 0 || item.mesh.vertexArray != vertexArray)
+        {
+            vertexArray = item.mesh.vertexArray;
+            GLState::bindVertexArray(vertexArray);
+            stats.vertexArrays++;
+        }
+        if (worldMatrices && material->modelMatrix.valid())
+            material->modelMatrix.set(worldMatrices[item.object]);
+        
+        const Mesh& mesh = item.mesh;
+        if (mesh.indexType)
+        {
+            const void* offset = (const void*)mesh.first;
+            if (item.instances > 1)
+                glDrawElementsInstanced(mesh.mode, mesh.count, mesh.indexType, offset, item.instances);
+            else
+                glDrawElements(mesh.mode, mesh.count, mesh.indexType, offset);
+        }
+        else
+        {
+            if (item.instances > 1)
+                glDrawArraysInstanced(mesh.mode, (GLint)mesh.first, mesh.count, item.instances);
+            else
+                glDrawArrays(mesh.mode, (GLint)mesh.first, mesh.count);
+        }
+        stats.drawCalls++;
+    }
+    // leave what the rest of the frame expects, GLState drops it if nothing changed
+    if (current)
+    {
+        GLState::disable(GL_BLEND);
+        GLState::disable(GL_CULL_FACE);
+        GLState::depthMask(true);
+    }
+    return stats;
+}
@@ -0,0 +1,117 @@
+//
+//  RenderQueue.hpp
+//  GameEngine
+//
+
+#ifndef RenderQueue_hpp
+#define RenderQueue_hpp
+
+#include "LinearArena.hpp"
+#include "shader.hpp"
+#include <glm/glm.hpp>
+#include <stdint.h>
+
+// State a draw needs besides its mesh. Items sharing a material are drawn
+// without touching any of it in between. Not copied into the queue, it
+// has to outlive every frame in flight that draws with it.
+struct Material
+{
+    static const int MAX_TEXTURES = 4;
+    
+    Material();
+    
+    // required, items without one are not queued
+    Program* program;
+    // bound to units 0..textureCount-1
+    GLuint textures[MAX_TEXTURES];
+    GLenum textureTargets[MAX_TEXTURES];
+    int textureCount;
+    // blended back to front without depth writes, after everything opaque
+    // of the same layer
+    bool translucent;
+    // back faces are culled otherwise
+    bool doubleSided;
+    // coarse ordering above everything else, 0..RenderQueue::LAYERS-1
+    uint8_t layer;
+    // uniform of the program above, set to each item's world matrix. optional
+    UniformHandle<glm::mat4> modelMatrix;
+    // unique, packed into sort keys
+    uint32_t id;
+};
+
+struct Mesh
+{
+    GLuint vertexArray;
+    GLenum mode;
+    // element type, 0 to draw with glDrawArrays
+    GLenum indexType;
+    GLsizei count;
+    // first vertex, or byte offset into the element buffer
+    GLintptr first;
+};
+
+struct DrawItem
+{
+    const Material* material;
+    Mesh mesh;
+    GLsizei instances;
+    // slot of the object, picks its world matrix
+    uint32_t object;
+};
+
+// What a queue sent to GL. State changes are the ones between adjacent
+// items, GLState drops whatever of those happened to be set already.
+struct RenderStats
+{
+    uint32_t drawCalls;
+    uint32_t programs;
+    uint32_t materials;
+    uint32_t vertexArrays;
+    uint32_t stateChanges() const { return programs + materials + vertexArrays; }
+};
+
+// Draw items of one frame, ordered by a 64 bit key so that neighbours
+// share as much state as possible. From the top:
+//
+//     opaque       layer 4 | 0 | program 12 | material 16 | depth 24 | 0 7
+//     translucent  layer 4 | 1 | ~depth 24 | program 12 | material 16 | 0 7
+//
+// Opaque items are grouped by state and go front to back inside a group
+// for early depth rejection, translucent ones go back to front first and
+// only share state where the order allows it.
+// Built and sorted on the main thread with storage from the frame arena,
+// drawn by the render thread. Trivially destructible, so it can live in
+// the arena itself.
+class RenderQueue
+{
+public:
+    static const int LAYERS = 16;
+    
+    // capacity is a hint, the queue grows inside the arena
+    RenderQueue(LinearArena& arena, uint32_t capacity);
+    
+    // depth is the distance from the camera along the view direction
+    void push(const DrawItem& item, float depth);
+    // stable radix sort of the keys
+    void sort();
+    // walk the sorted items, only calling into GLState where the next item
+    // differs. worldMatrices is indexed by DrawItem::object
+    RenderStats draw(const glm::mat4* worldMatrices) const;
+    
+    uint32_t getCount() const { return count; }
+    static uint64_t makeKey(const Material& material, float depth);
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t item;
+    };
+    LinearArena* arena;
+    DrawItem* items;
+    Entry* entries;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+#endif /* RenderQueue_hpp */
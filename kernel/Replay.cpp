@@ -0,0 +1,461 @@
+//
+//  Replay.cpp
+//  GameEngine
+//
+
+#include "Replay.hpp"
+#include "Camera.hpp"
+#include <GLFW/glfw3.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static const char MAGIC[4] = {'G', 'E', 'I', 'R'};
+static const uint8_t VERSION = 1;
+static const uint8_t EVENT_RECORD = 'E';
+static const uint8_t FRAME_RECORD = 'F';
+
+CameraState CameraState::capture()
+{
+    CameraState state;
+    const Camera& camera = Camera::get();
+    state.position = camera.getPosition();
+    state.yaw = camera.getYaw();
+    state.pitch = camera.getPitch();
+    state.fov = camera.getFOV();
+    return state;
+}
+
+void CameraState::restore() const
+{
+    Camera::get().init(position, glm::vec3(0, 1, 0), fov, yaw, pitch);
+}
+
+InputRecorder::InputRecorder()
+{
+    file = nullptr;
+    lastTime = 0;
+}
+
+InputRecorder::~InputRecorder()
+{
+    if (file)
+        fclose(file);
+}
+
+bool InputRecorder::open(const char* path)
+{
+    file = fopen(path, "wb");
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << " for recording" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void InputRecorder::begin(int64_t origin)
+{
+    lastTime = origin;
+    fwrite(MAGIC, 1, sizeof(MAGIC), file);
+    writeByte(VERSION);
+    CameraState camera = CameraState::capture();
+    writeFloat(camera.position.x);
+    writeFloat(camera.position.y);
+    writeFloat(camera.position.z);
+    writeFloat(camera.yaw);
+    writeFloat(camera.pitch);
+    writeFloat(camera.fov);
+}
+
+void InputRecorder::recordEvent(const InputEvent& event)
+{
+    writeByte(EVENT_RECORD);
+    writeByte((uint8_t)event.type);
+    writeTime(event.timestamp);
+    if (event.type == KEY_EVENT)
+    {
+        writeVarint((uint64_t)event.key);
+        writeByte((uint8_t)event.action);
+    }
+    else
+    {
+        writeFloat((float)event.x);
+        writeFloat((float)event.y);
+    }
+}
+
+void InputRecorder::recordFrame(int64_t start, int64_t latch)
+{
+    writeByte(FRAME_RECORD);
+    writeTime(start);
+    writeTime(latch);
+}
+
+void InputRecorder::writeByte(uint8_t value)
+{
+    fputc(value, file);
+}
+
+void InputRecorder::writeVarint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        writeByte((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    writeByte((uint8_t)value);
+}
+
+void InputRecorder::writeTime(int64_t time)
+{
+    // zigzag, events may be a little older than the frame they end up in
+    int64_t delta = time - lastTime;
+    lastTime = time;
+    writeVarint(((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+}
+
+void InputRecorder::writeFloat(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 4; i++)
+        writeByte((uint8_t)(bits >> (8 * i)));
+}
+
+// Reading side of the format above.
+class RecordingReader
+{
+public:
+    RecordingReader(const std::vector<uint8_t>& data) : data(data), offset(0), lastTime(0), failed(false) {}
+    
+    bool done() const { return offset >= data.size(); }
+    bool ok() const { return !failed; }
+    
+    uint8_t readByte()
+    {
+        if (offset >= data.size())
+        {
+            failed = true;
+            return 0;
+        }
+        return data[offset++];
+    }
+    uint64_t readVarint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = readByte();
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        failed = true;
+        return 0;
+    }
+    int64_t readTime()
+    {
+        uint64_t zigzag = readVarint();
+        lastTime += (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+        return lastTime;
+    }
+    float readFloat()
+    {
+        uint32_t bits = 0;
+        for (int i = 0; i < 4; i++)
+            bits |= (uint32_t)readByte() << (8 * i);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    
+private:
+    const std::vector<uint8_t>& data;
+    size_t offset;
+    int64_t lastTime;
+    bool failed;
+};
+
+InputReplay::InputReplay()
+{
+    camera = CameraState::capture();
+    current = 0;
+    origin = 0;
+}
+
+bool InputReplay::load(const char* path)
+{
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream.is_open())
+    {
+        std::cerr << "Impossible to open replay " << path << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(MAGIC) + 1 || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0 || data[4] != VERSION)
+    {
+        std::cerr << path << " is not an input recording" << std::endl;
+        return false;
+    }
+    
+    RecordingReader reader(data);
+    for (size_t i = 0; i < sizeof(MAGIC) + 1; i++)
+        reader.readByte();
+    camera.position.x = reader.readFloat();
+    camera.position.y = reader.readFloat();
+    camera.position.z = reader.readFloat();
+    camera.yaw = reader.readFloat();
+    camera.pitch = reader.readFloat();
+    camera.fov = reader.readFloat();
+    
+    // times are relative to the origin, which reads as 0
+    frames.clear();
+    ReplayFrame frame;
+    while (!reader.done() && reader.ok())
+    {
+        uint8_t tag = reader.readByte();
+        if (tag == EVENT_RECORD)
+        {
+            InputEvent event = {};
+            event.type = (InputEventType)reader.readByte();
+            event.timestamp = reader.readTime();
+            if (event.type == KEY_EVENT)
+            {
+                event.key = (int)reader.readVarint();
+                event.action = reader.readByte();
+            }
+            else
+            {
+                event.x = reader.readFloat();
+                event.y = reader.readFloat();
+            }
+            frame.events.push_back(event);
+        }
+        else if (tag == FRAME_RECORD)
+        {
+            frame.start = reader.readTime();
+            frame.latch = reader.readTime();
+            frames.push_back(frame);
+            frame.events.clear();
+        }
+        else
+            break;
+    }
+    if (!reader.ok())
+        std::cerr << "Replay " << path << " is truncated, keeping " << frames.size() << " frames" << std::endl;
+    printf("Loaded replay %s: %d frames\n", path, (int)frames.size());
+    return !frames.empty();
+}
+
+static int parseKey(const std::string& name)
+{
+    // letters and digits share their ASCII code with GLFW
+    if (name.size() == 1)
+        return toupper(name[0]);
+    return atoi(name.c_str());
+}
+
+// Script format, one command per line, '#' starts a comment:
+//   camera <x> <y> <z> <yaw> <pitch>   starting camera
+//   wait <seconds>
+//   hold <key> <seconds>               e.g. hold W 2.5
+//   look <dx> <dy> <seconds>           mouse motion in pixels
+//   scroll <amount>
+bool InputReplay::loadScript(const char* path, double frameTime)
+{
+    std::ifstream stream(path, std::ios::in);
+    if (!stream.is_open())
+    {
+        std::cerr << "Impossible to open flythrough script " << path << std::endl;
+        return false;
+    }
+    
+    const int64_t step = (int64_t)(frameTime * 1e9);
+    std::vector<InputEvent> events;
+    int64_t time = 0;
+    // the first cursor event only sets the reference position
+    double cursorX = 0.0, cursorY = 0.0;
+    InputEvent cursor = {};
+    cursor.type = CURSOR_EVENT;
+    events.push_back(cursor);
+    
+    std::string line;
+    int lineNumber = 0;
+    while (getline(stream, line))
+    {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string command;
+        if (!(words >> command))
+            continue;
+        
+        InputEvent event = {};
+        if (command == "camera")
+            words >> camera.position.x >> camera.position.y >> camera.position.z >> camera.yaw >> camera.pitch;
+        else if (command == "wait")
+        {
+            double seconds = 0.0;
+            words >> seconds;
+            time += (int64_t)(seconds * 1e9);
+        }
+        else if (command == "hold")
+        {
+            std::string key;
+            double seconds = 0.0;
+            words >> key >> seconds;
+            event.type = KEY_EVENT;
+            event.key = parseKey(key);
+            event.action = GLFW_PRESS;
+            event.timestamp = time;
+            events.push_back(event);
+            time += (int64_t)(seconds * 1e9);
+            event.action = GLFW_RELEASE;
+            event.timestamp = time;
+            events.push_back(event);
+        }
+        else if (command == "look")
+        {
+            double dx = 0.0, dy = 0.0, seconds = 0.0;
+            words >> dx >> dy >> seconds;
+            // one cursor event per frame, like a real mouse
+            int steps = std::max(1, (int)((int64_t)(seconds * 1e9) / step));
+            for (int i = 1; i <= steps; i++)
+            {
+                event.type = CURSOR_EVENT;
+                event.timestamp = time + (int64_t)(seconds * 1e9) * i / steps;
+                event.x = cursorX + dx * i / steps;
+                event.y = cursorY + dy * i / steps;
+                events.push_back(event);
+            }
+            cursorX += dx;
+            cursorY += dy;
+            time += (int64_t)(seconds * 1e9);
+        }
+        else if (command == "scroll")
+        {
+            event.type = SCROLL_EVENT;
+            event.timestamp = time;
+            words >> event.y;
+            events.push_back(event);
+        }
+        else
+        {
+            std::cerr << path << ":" << lineNumber << ": unknown command " << command << std::endl;
+            return false;
+        }
+    }
+    
+    // fixed frame times, every frame drains what happened since the last one
+    frames.clear();
+    size_t next = 0;
+    for (int64_t start = step; start <= time + step; start += step)
+    {
+        ReplayFrame frame;
+        frame.start = start;
+        frame.latch = start;
+        while (next < events.size() && events[next].timestamp <= frame.latch)
+            frame.events.push_back(events[next++]);
+        frames.push_back(frame);
+    }
+    printf("Loaded flythrough %s: %d frames\n", path, (int)frames.size());
+    return true;
+}
+
+void InputReplay::begin(int64_t origin)
+{
+    this->origin = origin;
+    current = 0;
+    timings.clear();
+    camera.restore();
+}
+
+bool InputReplay::finished() const
+{
+    return current >= frames.size();
+}
+
+const ReplayFrame& InputReplay::nextFrame()
+{
+    const ReplayFrame& frame = frames[current++];
+    shifted.start = origin + frame.start;
+    shifted.latch = origin + frame.latch;
+    shifted.events = frame.events;
+    for (InputEvent& event : shifted.events)
+        event.timestamp += origin;
+    return shifted;
+}
+
+void InputReplay::recordTiming(uint64_t frameIndex, double cpuMs, double renderMs)
+{
+    timings.push_back({frameIndex, cpuMs, renderMs, -1.0});
+}
+
+void InputReplay::setGpuTime(uint64_t frameIndex, double gpuMs)
+{
+    // the frame is one of the last few
+    for (size_t i = timings.size(); i > 0; i--)
+    {
+        if (timings[i - 1].frameIndex == frameIndex)
+        {
+            timings[i - 1].gpuMs = gpuMs;
+            return;
+        }
+    }
+}
+
+bool InputReplay::writeReport(const char* path) const
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        std::cerr << "Failed to write replay report to " << path << std::endl;
+        return false;
+    }
+    
+    size_t length = strlen(path);
+    bool json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+    if (json)
+    {
+        fprintf(file, "{\"frames\":[\n");
+        for (size_t i = 0; i < timings.size(); i++)
+            fprintf(file, "%s{\"frame\":%d,\"cpu_ms\":%.4f,\"render_ms\":%.4f,\"gpu_ms\":%.4f}",
+                    i ? ",\n" : "", (int)i, timings[i].cpuMs, timings[i].renderMs, timings[i].gpuMs);
+        fprintf(file, "\n]}\n");
+    }
+    else
+    {
+        fprintf(file, "frame,cpu_ms,render_ms,gpu_ms\n");
+        for (size_t i = 0; i < timings.size(); i++)
+            fprintf(file, "%d,%.4f,%.4f,%.4f\n", (int)i, timings[i].cpuMs, timings[i].renderMs, timings[i].gpuMs);
+    }
+    fclose(file);
+    
+    double cpu = 0.0, gpu = 0.0;
+    int gpuFrames = 0;
+    for (const Timing& timing : timings)
+    {
+        cpu += timing.cpuMs;
+        // -1 where the GPU time never resolved
+        if (timing.gpuMs >= 0.0)
+        {
+            gpu += timing.gpuMs;
+            gpuFrames++;
+        }
+    }
+    if (timings.empty())
+        return true;
+    if (gpuFrames > 0)
+        printf("Replay: %d frames, average CPU %.3f ms, GPU %.3f ms over %d frames, report in %s\n",
+               (int)timings.size(), cpu / timings.size(), gpu / gpuFrames, gpuFrames, path);
+    else
+        printf("Replay: %d frames, average CPU %.3f ms, no GPU timings, report in %s\n",
+               (int)timings.size(), cpu / timings.size(), path);
+    return true;
+}
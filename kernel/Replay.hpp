@@ -0,0 +1,101 @@
+//
+//  Replay.hpp
+//  GameEngine
+//
+
+#ifndef Replay_hpp
+#define Replay_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Input.hpp"
+
+// One recorded frame. start is when the frame began, latch is when the
+// camera input was latched, events are everything drained up to latch.
+struct ReplayFrame
+{
+    int64_t start;
+    int64_t latch;
+    std::vector<InputEvent> events;
+};
+
+struct CameraState
+{
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+    float fov;
+    
+    static CameraState capture();
+    void restore() const;
+};
+
+// Writes the input stream and frame times to a compact binary file:
+// a small header with the camera state, then tagged records where every
+// time is a zigzag varint delta to the previous one.
+class InputRecorder
+{
+public:
+    InputRecorder();
+    ~InputRecorder();
+    
+    bool open(const char* path);
+    // write the header, origin is the start of the frame before the first one
+    void begin(int64_t origin);
+    void recordEvent(const InputEvent& event);
+    void recordFrame(int64_t start, int64_t latch);
+    
+private:
+    FILE* file;
+    int64_t lastTime;
+    
+    void writeByte(uint8_t value);
+    void writeVarint(uint64_t value);
+    void writeTime(int64_t time);
+    void writeFloat(float value);
+};
+
+// Plays a recording or a scripted flythrough back with its own frame times
+// instead of the wall clock, and collects per frame timings.
+class InputReplay
+{
+public:
+    InputReplay();
+    ~InputReplay() = default;
+    
+    bool load(const char* path);
+    // text script, see Replay.cpp. frames advance by frameTime seconds
+    bool loadScript(const char* path, double frameTime = 1.0 / 60.0);
+    
+    // shift the frames onto the clock starting at origin, restore the camera
+    void begin(int64_t origin);
+    bool finished() const;
+    const ReplayFrame& nextFrame();
+    
+    // the GPU time of a frame arrives later through setGpuTime, -1 until then
+    void recordTiming(uint64_t frameIndex, double cpuMs, double renderMs);
+    void setGpuTime(uint64_t frameIndex, double gpuMs);
+    // JSON if the path ends in .json, CSV otherwise
+    bool writeReport(const char* path) const;
+    
+private:
+    CameraState camera;
+    // times relative to the origin
+    std::vector<ReplayFrame> frames;
+    size_t current;
+    int64_t origin;
+    ReplayFrame shifted;
+    
+    struct Timing
+    {
+        uint64_t frameIndex;
+        double cpuMs;
+        double renderMs;
+        double gpuMs;
+    };
+    std::vector<Timing> timings;
+};
+
+#endif /* Replay_hpp */
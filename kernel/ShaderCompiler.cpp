@@ -0,0 +1,300 @@
+//
+//  ShaderCompiler.cpp
+//  GameEngine
+//
+
+#include "ShaderCompiler.hpp"
+#include "ProgramCache.hpp"
+#include "ShaderSource.hpp"
+#include "ShaderWatcher.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+struct PendingProgram
+{
+    Program* program;
+    GLuint id;
+    uint64_t key;
+    std::vector<GLuint> shaders;
+    std::vector<std::string> paths;
+    // replaces the id of a READY program instead of giving it its first one
+    bool reload;
+    // polls since submit, see poll()
+    int age;
+};
+
+static std::vector<PendingProgram> pending;
+// mirrors pending.size() for the ui, which may run on another thread
+static std::atomic<int> pending_count(0);
+static bool parallel_compile = false;
+static bool stall_reported = false;
+
+void ShaderCompiler::init()
+{
+#ifndef __APPLE__
+    parallel_compile = GLEW_KHR_parallel_shader_compile;
+    if (parallel_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+#endif
+}
+
+bool ShaderCompiler::hasParallelCompile()
+{
+    return parallel_compile;
+}
+
+static GLenum shaderStage(Program::ShaderType type)
+{
+    if (type == Program::vertex)
+        return GL_VERTEX_SHADER;
+    if (type == Program::fragment)
+        return GL_FRAGMENT_SHADER;
+    return GL_GEOMETRY_SHADER;
+}
+
+void ShaderCompiler::submit(Program& program, const char* const* paths, const Program::ShaderType* types, int count,
+                            const std::vector<std::string>& defines)
+{
+    PROFILE_SCOPE("ShaderCompiler::submit");
+    cancel(program);
+    if (program.id)
+        GLState::deleteProgram(program.id);
+    program.id = 0;
+    program.status = Program::FAILED;
+    program.reflectUniforms();
+    program.sourcePaths.assign(paths, paths + count);
+    program.sourceTypes.assign(types, types + count);
+    program.sourceDefines = defines;
+    build(program, false);
+    ShaderWatcher::watch(program);
+}
+
+bool ShaderCompiler::reload(Program& program)
+{
+    if (program.sourcePaths.empty())
+        return false;
+    PROFILE_SCOPE("ShaderCompiler::reload");
+    if (!parallel_compile && !stall_reported)
+    {
+        // nothing tells us when the driver is done, collecting the link waits for it
+        std::cerr << "No GL_KHR_parallel_shader_compile, each shader reload stalls the frame that collects it"
+                  << std::endl;
+        stall_reported = true;
+    }
+    // a build still in flight is simply started over
+    bool replace = program.status == Program::READY;
+    cancel(program);
+    if (!replace)
+        program.status = Program::FAILED;
+    build(program, replace);
+    // includes may have changed
+    ShaderWatcher::watch(program);
+    return true;
+}
+
+// Swap a freshly linked id in for the current one.
+static void replaceProgram(Program& program, GLuint id)
+{
+    if (program.id)
+        GLState::deleteProgram(program.id);
+    program.id = id;
+}
+
+void ShaderCompiler::build(Program& program, bool reload)
+{
+    size_t count = program.sourcePaths.size();
+    std::vector<std::string> sources(count);
+    std::vector<GLenum> stages(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        // a reload that cannot read its sources keeps the old program
+        if (!ShaderSource::get(program.sourcePaths[i], program.sourceDefines, sources[i]))
+            return;
+        stages[i] = shaderStage(program.sourceTypes[i]);
+    }
+    uint64_t key = ProgramCache::makeKey(sources, stages);
+    GLuint cached = ProgramCache::load(key);
+    if (cached)
+    {
+        replaceProgram(program, cached);
+        program.status = Program::READY;
+        program.reflectUniforms();
+        return;
+    }
+    
+    // compile and link without asking for any status in between
+    PendingProgram job;
+    job.program = &program;
+    job.key = key;
+    job.reload = reload;
+    job.age = 0;
+    job.id = glCreateProgram();
+    if (ProgramCache::isAvailable())
+        glProgramParameteri(job.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    for (size_t i = 0; i < count; i++)
+    {
+        GLuint shader = glCreateShader(stages[i]);
+        const char* source = sources[i].c_str();
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        glAttachShader(job.id, shader);
+        job.shaders.push_back(shader);
+        job.paths.push_back(program.sourcePaths[i]);
+    }
+    glLinkProgram(job.id);
+    if (!reload)
+        program.status = Program::PENDING;
+    pending.push_back(job);
+    pending_count.store((int)pending.size());
+}
+
+static void printLog(const std::string& what, const std::vector<char>& log)
+{
+    if (log.size() > 1)
+        std::cerr << what << ":\n" << log.data() << std::endl;
+}
+
+// The link is done, collect the result.
+void ShaderCompiler::complete(PendingProgram& job)
+{
+    Program& program = *job.program;
+    GLint linked = GL_FALSE;
+    glGetProgramiv(job.id, GL_LINK_STATUS, &linked);
+    
+    // only now look at the compile logs, warnings are printed but do not fail
+    for (size_t i = 0; i < job.shaders.size(); i++)
+    {
+        GLint length = 0;
+        glGetShaderiv(job.shaders[i], GL_INFO_LOG_LENGTH, &length);
+        if (length > 1)
+        {
+            std::vector<char> log(length + 1);
+            glGetShaderInfoLog(job.shaders[i], length, NULL, log.data());
+            printLog(job.paths[i], log);
+        }
+    }
+    GLint length = 0;
+    glGetProgramiv(job.id, GL_INFO_LOG_LENGTH, &length);
+    if (length > 1)
+    {
+        std::vector<char> log(length + 1);
+        glGetProgramInfoLog(job.id, length, NULL, log.data());
+        printLog("Linking " + job.paths[0], log);
+    }
+    
+    // Detach and delete the shaders as they are no longer needed.
+    for (GLuint shader : job.shaders)
+    {
+        glDetachShader(job.id, shader);
+        glDeleteShader(shader);
+    }
+    if (linked != GL_TRUE)
+    {
+        glDeleteProgram(job.id);
+        if (job.reload)
+            std::cerr << "Reloading " << job.paths[0] << " failed, keeping the previous program" << std::endl;
+        else
+            program.status = Program::FAILED;
+        return;
+    }
+    ProgramCache::store(job.key, job.id);
+    replaceProgram(program, job.id);
+    program.status = Program::READY;
+    program.reflectUniforms();
+}
+
+int ShaderCompiler::poll()
+{
+    if (pending.empty())
+        return 0;
+    PROFILE_SCOPE("ShaderCompiler::poll");
+    int finished = 0;
+    bool reloaded = false;
+    for (size_t i = 0; i < pending.size();)
+    {
+        PendingProgram& job = pending[i];
+        job.age++;
+        if (parallel_compile)
+        {
+            GLint done = GL_FALSE;
+            glGetProgramiv(job.id, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+            {
+                i++;
+                continue;
+            }
+        }
+        else if (job.reload && (reloaded || job.age < 2))
+        {
+            // reloads are collected one per frame and not before the frame
+            // after they were queued, to give the driver a head start. the
+            // old program draws meanwhile
+            i++;
+            continue;
+        }
+        // without the extension the status query blocks until the link is
+        // done, which stalls this frame for however long is left of it
+        reloaded |= job.reload;
+        complete(job);
+        pending.erase(pending.begin() + i);
+        finished++;
+    }
+    pending_count.store((int)pending.size());
+    return finished;
+}
+
+void ShaderCompiler::finish(Program& program)
+{
+    for (size_t i = 0; i < pending.size();)
+    {
+        if (pending[i].program != &program)
+        {
+            i++;
+            continue;
+        }
+        complete(pending[i]);
+        pending.erase(pending.begin() + i);
+    }
+    pending_count.store((int)pending.size());
+}
+
+void ShaderCompiler::finishAll()
+{
+    for (PendingProgram& job : pending)
+        complete(job);
+    pending.clear();
+    pending_count.store(0);
+}
+
+void ShaderCompiler::cancel(Program& program)
+{
+    for (size_t i = 0; i < pending.size();)
+    {
+        if (pending[i].program != &program)
+        {
+            i++;
+            continue;
+        }
+        for (GLuint shader : pending[i].shaders)
+            glDeleteShader(shader);
+        glDeleteProgram(pending[i].id);
+        // a cancelled reload leaves the current program alone
+        if (!pending[i].reload)
+            program.status = Program::FAILED;
+        pending.erase(pending.begin() + i);
+    }
+    pending_count.store((int)pending.size());
+}
+
+int ShaderCompiler::getPendingCount()
+{
+    return pending_count.load();
+}
@@ -0,0 +1,53 @@
+//
+//  ShaderCompiler.hpp
+//  GameEngine
+//
+
+#ifndef ShaderCompiler_hpp
+#define ShaderCompiler_hpp
+
+#include "shader.hpp"
+#include <string>
+#include <vector>
+
+struct PendingProgram;
+
+// Builds programs without waiting on the driver. submit() issues every
+// compile and the link right away and never asks for a status, so the
+// driver can work on all of them at once (GL_KHR_parallel_shader_compile
+// spreads them over its compiler threads). The program stays PENDING and
+// draws with its fallback until poll() sees the link complete.
+// Everything here runs on the thread that owns the GL context.
+class ShaderCompiler
+{
+public:
+    // hands all hardware threads to the driver's compiler if it can use them
+    static void init();
+    static bool hasParallelCompile();
+    
+    // sources go through ShaderSource with the given defines. a program
+    // binary cache hit is READY immediately
+    static void submit(Program& program, const char* const* paths, const Program::ShaderType* types, int count,
+                       const std::vector<std::string>& defines = std::vector<std::string>());
+    // rebuild from the sources it was submitted with. a READY program keeps
+    // drawing with its current id, poll() swaps the new one in once it
+    // linked and drops it if it failed. without GL_KHR_parallel_shader_compile
+    // the frame that collects the reload waits for the link. false if there
+    // is nothing to rebuild
+    static bool reload(Program& program);
+    // once per frame: finish the programs whose link completed, returns how many
+    static int poll();
+    // block until the program is READY or FAILED
+    static void finish(Program& program);
+    static void finishAll();
+    // forget a pending build or reload, its GL objects are deleted
+    static void cancel(Program& program);
+    // any thread
+    static int getPendingCount();
+    
+private:
+    static void build(Program& program, bool reload);
+    static void complete(PendingProgram& job);
+};
+
+#endif /* ShaderCompiler_hpp */
@@ -0,0 +1,367 @@
+//
+//  ShaderSource.cpp
+//  GameEngine
+//
+
+#include "ShaderSource.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+struct SourceFile
+{
+    std::string text;
+    // files named by #include, resolved
+    std::vector<std::string> includes;
+};
+
+static std::mutex source_lock;
+static std::vector<std::string> include_directories;
+static std::unordered_map<std::string, SourceFile> files;
+// file -> files that include it directly
+static std::map<std::string, std::set<std::string>> included_by;
+// "path|defines" -> expansion, and path -> its expansion keys
+static std::unordered_map<std::string, std::string> expansions;
+static std::map<std::string, std::set<std::string>> expansion_keys;
+// path -> every file its expansion used
+static std::map<std::string, std::vector<std::string>> dependencies;
+
+void ShaderSource::addIncludeDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> guard(source_lock);
+    include_directories.push_back(directory);
+}
+
+// The whole file through one mapping, no line by line reads.
+static bool mapFile(const std::string& path, std::string& text)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    text.clear();
+    if (info.st_size > 0)
+    {
+        void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+        text.assign(static_cast<const char*>(data), (size_t)info.st_size);
+        munmap(data, (size_t)info.st_size);
+    }
+    close(fd);
+    return true;
+}
+
+static bool fileExists(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+static std::string directoryOf(const std::string& path)
+{
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Collapse "." and ".." so every file has exactly one name in the graph.
+static std::string normalizePath(const std::string& path)
+{
+    if (path.empty())
+        return path;
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= path.size())
+    {
+        size_t slash = path.find('/', start);
+        if (slash == std::string::npos)
+            slash = path.size();
+        std::string part = path.substr(start, slash - start);
+        if (part == "..")
+        {
+            if (!parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else if (path[0] != '/')
+                parts.push_back(part);
+        }
+        else if (!part.empty() && part != ".")
+            parts.push_back(part);
+        start = slash + 1;
+    }
+    std::string result = path[0] == '/' ? "/" : "";
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+        if (i > 0)
+            result += "/";
+        result += parts[i];
+    }
+    return result;
+}
+
+static std::string resolveInclude(const std::string& from, const std::string& name)
+{
+    std::string local = normalizePath(directoryOf(from) + name);
+    if (fileExists(local))
+        return local;
+    for (const std::string& directory : include_directories)
+    {
+        std::string candidate = normalizePath(directory + "/" + name);
+        if (fileExists(candidate))
+            return candidate;
+    }
+    return local;
+}
+
+// Returns the include name if the line is #include "name" or <name>.
+static bool parseInclude(const char* line, const char* end, std::string& name)
+{
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    if (line == end || *line != '#')
+        return false;
+    line++;
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    if (end - line < 7 || strncmp(line, "include", 7) != 0)
+        return false;
+    line += 7;
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    if (line == end || (*line != '"' && *line != '<'))
+        return false;
+    char close = *line == '"' ? '"' : '>';
+    const char* start = ++line;
+    while (line < end && *line != close)
+        line++;
+    if (line == end)
+        return false;
+    name.assign(start, line);
+    return true;
+}
+
+static bool isVersion(const char* line, const char* end)
+{
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    return end - line >= 8 && strncmp(line, "#version", 8) == 0;
+}
+
+// Caller holds source_lock.
+static SourceFile* loadFile(const std::string& path)
+{
+    auto found = files.find(path);
+    if (found != files.end())
+        return &found->second;
+    SourceFile file;
+    if (!mapFile(path, file.text))
+        return nullptr;
+    // remember the include edges so invalidation can walk them backwards
+    const char* line = file.text.data();
+    const char* end = line + file.text.size();
+    while (line < end)
+    {
+        const char* next = static_cast<const char*>(memchr(line, '\n', end - line));
+        const char* lineEnd = next ? next : end;
+        std::string name;
+        if (parseInclude(line, lineEnd, name))
+        {
+            std::string resolved = resolveInclude(path, name);
+            file.includes.push_back(resolved);
+            included_by[resolved].insert(path);
+        }
+        line = next ? next + 1 : end;
+    }
+    return &files.emplace(path, std::move(file)).first->second;
+}
+
+struct Expansion
+{
+    std::string out;
+    std::string version;
+    std::vector<std::string> used;
+    std::set<std::string> active;
+    std::set<std::string> done;
+};
+
+// Caller holds source_lock.
+static bool expand(const std::string& path, Expansion& state)
+{
+    if (state.active.count(path))
+    {
+        std::cerr << "Shader include cycle through " << path << std::endl;
+        return false;
+    }
+    // every file at most once, like an implicit include guard
+    if (!state.done.insert(path).second)
+        return true;
+    SourceFile* file = loadFile(path);
+    if (!file)
+    {
+        std::cerr << "Impossible to open " << path << ". "
+            << "Check to make sure the file exists and you passed in the "
+            << "right filepath!"
+            << std::endl;
+        return false;
+    }
+    state.active.insert(path);
+    int fileIndex = (int)state.used.size();
+    state.used.push_back(path);
+    
+    // the GLSL #line takes a source number instead of a name, the comment maps it back
+    state.out.append("// ").append(std::to_string(fileIndex)).append(": ").append(path).append("\n");
+    state.out.append("#line 1 ").append(std::to_string(fileIndex)).append("\n");
+    const char* begin = file->text.data();
+    const char* line = begin;
+    const char* end = line + file->text.size();
+    int lineNumber = 1;
+    while (line < end)
+    {
+        const char* next = static_cast<const char*>(memchr(line, '\n', end - line));
+        const char* lineEnd = next ? next : end;
+        std::string name;
+        if (parseInclude(line, lineEnd, name))
+        {
+            if (!expand(resolveInclude(path, name), state))
+                return false;
+            state.out.append("#line ").append(std::to_string(lineNumber + 1)).append(" ")
+                .append(std::to_string(fileIndex)).append("\n");
+        }
+        else if (isVersion(line, lineEnd))
+        {
+            // hoisted in front of the defines, keep the line count intact
+            if (state.version.empty())
+                state.version.assign(line, lineEnd);
+            state.out.append("\n");
+        }
+        else
+        {
+            state.out.append(line, lineEnd).append("\n");
+        }
+        line = next ? next + 1 : end;
+        lineNumber++;
+    }
+    state.active.erase(path);
+    return true;
+}
+
+static std::string expansionKey(const std::string& path, const std::vector<std::string>& defines)
+{
+    std::string key = path;
+    for (const std::string& define : defines)
+        key.append("|").append(define);
+    return key;
+}
+
+bool ShaderSource::get(const std::string& file, const std::vector<std::string>& defines, std::string& expanded)
+{
+    std::string path = normalizePath(file);
+    std::lock_guard<std::mutex> guard(source_lock);
+    std::string key = expansionKey(path, defines);
+    auto cached = expansions.find(key);
+    if (cached != expansions.end())
+    {
+        expanded = cached->second;
+        return true;
+    }
+    
+    Expansion state;
+    if (!expand(path, state))
+        return false;
+    std::string header = state.version.empty() ? std::string() : state.version + "\n";
+    for (const std::string& define : defines)
+    {
+        // "NAME VALUE" or "NAME=VALUE"
+        std::string text = define;
+        size_t equals = text.find('=');
+        if (equals != std::string::npos)
+            text[equals] = ' ';
+        header.append("#define ").append(text).append("\n");
+    }
+    expanded = header + state.out;
+    
+    expansions[key] = expanded;
+    expansion_keys[path].insert(key);
+    dependencies[path] = state.used;
+    return true;
+}
+
+// Caller holds source_lock.
+static void collectDependents(const std::string& path, std::set<std::string>& result)
+{
+    if (!result.insert(path).second)
+        return;
+    auto found = included_by.find(path);
+    if (found == included_by.end())
+        return;
+    for (const std::string& parent : found->second)
+        collectDependents(parent, result);
+}
+
+void ShaderSource::invalidate(const std::string& file)
+{
+    std::string path = normalizePath(file);
+    std::lock_guard<std::mutex> guard(source_lock);
+    std::set<std::string> affected;
+    collectDependents(path, affected);
+    
+    // the file's own include edges are re-read with it
+    auto loaded = files.find(path);
+    if (loaded != files.end())
+    {
+        for (const std::string& include : loaded->second.includes)
+            included_by[include].erase(path);
+        files.erase(loaded);
+    }
+    // only expansions that used the file are rebuilt, and only when asked for
+    for (const std::string& dependent : affected)
+    {
+        auto keys = expansion_keys.find(dependent);
+        if (keys == expansion_keys.end())
+            continue;
+        for (const std::string& key : keys->second)
+            expansions.erase(key);
+        expansion_keys.erase(keys);
+    }
+}
+
+std::vector<std::string> ShaderSource::getDependents(const std::string& path)
+{
+    std::lock_guard<std::mutex> guard(source_lock);
+    std::set<std::string> affected;
+    collectDependents(normalizePath(path), affected);
+    return std::vector<std::string>(affected.begin(), affected.end());
+}
+
+std::vector<std::string> ShaderSource::getDependencies(const std::string& path)
+{
+    std::lock_guard<std::mutex> guard(source_lock);
+    auto found = dependencies.find(normalizePath(path));
+    if (found == dependencies.end())
+        return std::vector<std::string>();
+    return found->second;
+}
+
+void ShaderSource::clear()
+{
+    std::lock_guard<std::mutex> guard(source_lock);
+    files.clear();
+    included_by.clear();
+    expansions.clear();
+    expansion_keys.clear();
+    dependencies.clear();
+}
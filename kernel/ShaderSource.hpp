@@ -0,0 +1,38 @@
+//
+//  ShaderSource.hpp
+//  GameEngine
+//
+
+#ifndef ShaderSource_hpp
+#define ShaderSource_hpp
+
+#include <string>
+#include <vector>
+
+// Loads and preprocesses shader files. Files are mapped and read once,
+// #include "file" is inlined (every file at most once per expansion) and
+// the requested defines are injected right after #version. Raw files and
+// expansions are cached in memory, and the include graph is remembered so
+// a changed file only invalidates the expansions that actually use it.
+// Thread safe.
+class ShaderSource
+{
+public:
+    // searched after the directory of the including file
+    static void addIncludeDirectory(const std::string& directory);
+    
+    // defines are "NAME" or "NAME VALUE". false if a file is missing or
+    // includes form a cycle, the error is printed
+    static bool get(const std::string& path, const std::vector<std::string>& defines, std::string& expanded);
+    
+    // the file changed on disk: drop it and every expansion that includes it
+    static void invalidate(const std::string& path);
+    // every file whose expansion includes path, directly or not, path included
+    static std::vector<std::string> getDependents(const std::string& path);
+    // files the last expansion of path pulled in, path included
+    static std::vector<std::string> getDependencies(const std::string& path);
+    
+    static void clear();
+};
+
+#endif /* ShaderSource_hpp */
@@ -0,0 +1,114 @@
+//
+//  ShaderVariants.cpp
+//  GameEngine
+//
+
+#include "ShaderVariants.hpp"
+#include "ShaderCompiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+ShaderVariants::ShaderVariants(const char* vertexPath_, const char* fragmentPath_, const std::vector<std::string>& keywords_,
+                               const char* geometryPath_)
+    : vertexPath(vertexPath_), fragmentPath(fragmentPath_), geometryPath(geometryPath_ ? geometryPath_ : ""),
+      keywords(keywords_), fallback(nullptr)
+{
+    if (keywords.size() > MAX_KEYWORDS)
+    {
+        std::cerr << vertexPath << ": only " << MAX_KEYWORDS << " keywords are supported, dropping the rest" << std::endl;
+        keywords.resize(MAX_KEYWORDS);
+    }
+}
+
+uint32_t ShaderVariants::getKeywordBit(const char* keyword) const
+{
+    for (size_t i = 0; i < keywords.size(); i++)
+    {
+        if (keywords[i] == keyword)
+            return 1u << i;
+    }
+    return 0;
+}
+
+uint32_t ShaderVariants::makeKey(const std::vector<std::string>& names) const
+{
+    uint32_t key = 0;
+    for (const std::string& name : names)
+        key |= getKeywordBit(name.c_str());
+    return key;
+}
+
+Program& ShaderVariants::get(uint32_t key)
+{
+    auto found = variants.find(key);
+    if (found == variants.end())
+    {
+        build(key);
+        found = variants.find(key);
+    }
+    found->second.used = true;
+    return *found->second.program;
+}
+
+void ShaderVariants::warmup(const std::vector<uint32_t>& keys)
+{
+    for (uint32_t key : keys)
+    {
+        if (variants.find(key) == variants.end())
+            build(key);
+    }
+}
+
+Program& ShaderVariants::build(uint32_t key)
+{
+    // only the keywords this variant uses, so key 0 is the plain shader
+    std::vector<std::string> defines;
+    for (size_t i = 0; i < keywords.size(); i++)
+    {
+        if (key & (1u << i))
+            defines.push_back(keywords[i]);
+    }
+    
+    Program* program = new Program();
+    Variant& variant = variants[key];
+    variant.program.reset(program);
+    variant.used = false;
+    const char* paths[] = { vertexPath.c_str(), fragmentPath.c_str(), geometryPath.c_str() };
+    const Program::ShaderType types[] = { Program::vertex, Program::fragment, Program::geometry };
+    ShaderCompiler::submit(*program, paths, types, geometryPath.empty() ? 2 : 3, defines);
+    
+    if (key != 0)
+    {
+        auto base = variants.find(0);
+        program->setFallback(base != variants.end() ? base->second.program.get() : &build(0));
+    }
+    else
+        program->setFallback(fallback);
+    return *program;
+}
+
+std::vector<uint32_t> ShaderVariants::getUsedKeys() const
+{
+    std::vector<uint32_t> keys;
+    for (const auto& variant : variants)
+    {
+        if (variant.second.used)
+            keys.push_back(variant.first);
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+void ShaderVariants::setFallback(const Program* fallback_)
+{
+    fallback = fallback_;
+    auto base = variants.find(0);
+    if (base != variants.end())
+        base->second.program->setFallback(fallback);
+}
+
+int ShaderVariants::getVariantCount() const
+{
+    return (int)variants.size();
+}
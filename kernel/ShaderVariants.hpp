@@ -0,0 +1,64 @@
+//
+//  ShaderVariants.hpp
+//  GameEngine
+//
+
+#ifndef ShaderVariants_hpp
+#define ShaderVariants_hpp
+
+#include "shader.hpp"
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// An uber-shader with feature keywords. Each keyword is one bit of a
+// variant key, a set bit compiles the shader with #define KEYWORD. A
+// variant is only built the first time its key is asked for, through
+// ShaderCompiler, so the program binary cache covers variants as well.
+// Until a variant is ready it draws with the base variant (key 0), or the
+// fallback set here when the base is not ready either. GL thread only.
+class ShaderVariants
+{
+public:
+    static const int MAX_KEYWORDS = 32;
+    
+    ShaderVariants(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& keywords,
+                   const char* geometryPath = nullptr);
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+    
+    // 0 for an unknown keyword
+    uint32_t getKeywordBit(const char* keyword) const;
+    uint32_t makeKey(const std::vector<std::string>& keywords) const;
+    
+    // compiled on first use, check isReady() before relying on it
+    Program& get(uint32_t key);
+    // start building variants that are known to be needed soon without
+    // using them, the driver compiles them in the background
+    void warmup(const std::vector<uint32_t>& keys);
+    // every key that was asked for, worth feeding to warmup next run
+    std::vector<uint32_t> getUsedKeys() const;
+    
+    void setFallback(const Program* fallback_);
+    int getVariantCount() const;
+    
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::string geometryPath;
+    std::vector<std::string> keywords;
+    const Program* fallback;
+    struct Variant
+    {
+        std::unique_ptr<Program> program;
+        // asked for through get(), warmup and fallbacks do not count
+        bool used;
+    };
+    std::unordered_map<uint32_t, Variant> variants;
+    
+    Program& build(uint32_t key);
+};
+
+#endif /* ShaderVariants_hpp */
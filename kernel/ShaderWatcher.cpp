@@ -0,0 +1,255 @@
+//
+//  ShaderWatcher.cpp
+//  GameEngine
+//
+
+#include "ShaderWatcher.hpp"
+#include "ShaderCompiler.hpp"
+#include "ShaderSource.hpp"
+#include "Profiler.hpp"
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+struct WatchedProgram
+{
+    Program* program;
+    // every file its last expansion read
+    std::vector<std::string> files;
+};
+
+static std::vector<WatchedProgram> programs;
+// watched file and its modification time, which only the polling fallback looks at
+static std::unordered_map<std::string, int64_t> files;
+static bool active = false;
+
+#ifdef __linux__
+static int inotify_fd = -1;
+static std::unordered_map<std::string, int> directory_watches;
+static std::unordered_map<int, std::string> watched_directories;
+#else
+static std::chrono::steady_clock::time_point last_scan;
+#endif
+
+static int64_t modificationTime(const std::string& path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return 0;
+    return (int64_t)info.st_mtime;
+}
+
+// Paths come normalized from ShaderSource, relative ones without "./".
+static std::string directoryOf(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos)
+        return ".";
+    if (slash == 0)
+        return "/";
+    return path.substr(0, slash);
+}
+
+static std::string joinPath(const std::string& directory, const char* name)
+{
+    if (directory == ".")
+        return name;
+    if (directory == "/")
+        return std::string("/") + name;
+    return directory + "/" + name;
+}
+
+// Editors often save by writing a new file and renaming it over the old
+// one, which a watch on the file itself would lose. Watch the directory.
+static void watchDirectory(const std::string& path)
+{
+#ifdef __linux__
+    if (inotify_fd < 0)
+        return;
+    std::string directory = directoryOf(path);
+    if (directory_watches.count(directory))
+        return;
+    int wd = inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0)
+    {
+        std::cerr << "Cannot watch " << directory << " for shader changes" << std::endl;
+        return;
+    }
+    directory_watches[directory] = wd;
+    watched_directories[wd] = directory;
+#else
+    (void)path;
+#endif
+}
+
+static void addFile(const std::string& path)
+{
+    if (files.count(path))
+        return;
+    files[path] = modificationTime(path);
+    watchDirectory(path);
+}
+
+bool ShaderWatcher::init()
+{
+    if (active)
+        return true;
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0)
+    {
+        std::cerr << "inotify unavailable, shader hot reload is off" << std::endl;
+        return false;
+    }
+#else
+    last_scan = std::chrono::steady_clock::now();
+#endif
+    active = true;
+    // programs built before init
+    for (auto& file : files)
+        watchDirectory(file.first);
+    return true;
+}
+
+void ShaderWatcher::shutdown()
+{
+#ifdef __linux__
+    if (inotify_fd >= 0)
+        close(inotify_fd);
+    inotify_fd = -1;
+    directory_watches.clear();
+    watched_directories.clear();
+#endif
+    programs.clear();
+    files.clear();
+    active = false;
+}
+
+bool ShaderWatcher::isActive()
+{
+    return active;
+}
+
+void ShaderWatcher::watch(Program& program)
+{
+    WatchedProgram* watched = nullptr;
+    for (WatchedProgram& entry : programs)
+    {
+        if (entry.program == &program)
+            watched = &entry;
+    }
+    if (!watched)
+    {
+        programs.push_back(WatchedProgram{ &program, {} });
+        watched = &programs.back();
+    }
+    watched->files.clear();
+    for (const std::string& source : program.getSourcePaths())
+    {
+        std::vector<std::string> dependencies = ShaderSource::getDependencies(source);
+        watched->files.insert(watched->files.end(), dependencies.begin(), dependencies.end());
+    }
+    for (const std::string& file : watched->files)
+        addFile(file);
+}
+
+void ShaderWatcher::unwatch(Program& program)
+{
+    // files stay watched, the next program is likely to use them again
+    programs.erase(std::remove_if(programs.begin(), programs.end(),
+                                  [&](const WatchedProgram& entry) { return entry.program == &program; }),
+                   programs.end());
+}
+
+// Files that changed since the last call.
+static std::set<std::string> collectChanges()
+{
+    std::set<std::string> changed;
+#ifdef __linux__
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;)
+    {
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+            // events were dropped, assume everything changed
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                for (auto& file : files)
+                    changed.insert(file.first);
+                continue;
+            }
+            auto directory = watched_directories.find(event->wd);
+            if (event->len == 0 || directory == watched_directories.end())
+                continue;
+            std::string path = joinPath(directory->second, event->name);
+            if (files.count(path))
+                changed.insert(path);
+        }
+    }
+#else
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_scan < std::chrono::milliseconds(250))
+        return changed;
+    last_scan = now;
+    for (auto& file : files)
+    {
+        int64_t time = modificationTime(file.first);
+        if (time != file.second)
+        {
+            file.second = time;
+            changed.insert(file.first);
+        }
+    }
+#endif
+    return changed;
+}
+
+int ShaderWatcher::poll()
+{
+    if (!active)
+        return 0;
+    std::set<std::string> changed = collectChanges();
+    if (changed.empty())
+        return 0;
+    PROFILE_SCOPE("ShaderWatcher::poll");
+    
+    // find the programs first, invalidating forgets the include edges
+    std::vector<Program*> affected;
+    for (const WatchedProgram& watched : programs)
+    {
+        for (const std::string& file : watched.files)
+        {
+            if (changed.count(file))
+            {
+                affected.push_back(watched.program);
+                break;
+            }
+        }
+    }
+    for (const std::string& file : changed)
+        ShaderSource::invalidate(file);
+    // reload rewrites the watch list, so work on a copy
+    for (Program* program : affected)
+        ShaderCompiler::reload(*program);
+    return (int)affected.size();
+}
+
+int ShaderWatcher::getWatchedFileCount()
+{
+    return (int)files.size();
+}
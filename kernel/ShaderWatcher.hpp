@@ -0,0 +1,33 @@
+//
+//  ShaderWatcher.hpp
+//  GameEngine
+//
+
+#ifndef ShaderWatcher_hpp
+#define ShaderWatcher_hpp
+
+class Program;
+
+// Reloads programs whose shader files changed on disk, includes too.
+// Linux gets change events from inotify on the directories of the files,
+// elsewhere the modification times are checked a few times per second.
+// Changed programs go back through ShaderCompiler::reload, so they keep
+// drawing with the old id until the new one linked, and keep it for good
+// if the edit does not compile. GL thread only.
+class ShaderWatcher
+{
+public:
+    static bool init();
+    static void shutdown();
+    static bool isActive();
+    
+    // ShaderCompiler calls these, watch again after a rebuild picks up new includes
+    static void watch(Program& program);
+    static void unwatch(Program& program);
+    
+    // once per frame before ShaderCompiler::poll, returns the programs reloaded
+    static int poll();
+    static int getWatchedFileCount();
+};
+
+#endif /* ShaderWatcher_hpp */
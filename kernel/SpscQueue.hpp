@@ -0,0 +1,59 @@
+//
+//  SpscQueue.hpp
+//  GameEngine
+//
+
+#ifndef SpscQueue_hpp
+#define SpscQueue_hpp
+
+#include <atomic>
+#include <stddef.h>
+
+// Bounded lock-free ring buffer for exactly one producer and one consumer
+// thread. Capacity must be a power of two.
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+public:
+    SpscQueue() : head(0), tail(0) {}
+    
+    // producer, false when full
+    bool push(const T& value)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[t & (Capacity - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // consumer, the oldest item or nullptr when empty
+    const T* front() const
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return nullptr;
+        return &items[h & (Capacity - 1)];
+    }
+    
+    // consumer, drop the item returned by front()
+    void pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    
+    size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+    
+private:
+    // keep the indices on separate cache lines so the threads do not fight
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) T items[Capacity];
+};
+
+#endif /* SpscQueue_hpp */
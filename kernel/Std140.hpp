@@ -0,0 +1,91 @@
+//
+//  Std140.hpp
+//  GameEngine
+//
+
+#ifndef Std140_hpp
+#define Std140_hpp
+
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Base alignment and size of each type in a std140 uniform block.
+// Scalars take 4 bytes, vec3 is aligned like a vec4, matrices are arrays
+// of vec4 columns.
+template<typename T> struct Std140;
+template<> struct Std140<float> { static const size_t alignment = 4, size = 4; };
+template<> struct Std140<int> { static const size_t alignment = 4, size = 4; };
+template<> struct Std140<uint32_t> { static const size_t alignment = 4, size = 4; };
+// GLSL bools are 32 bits in a block
+template<> struct Std140<bool> { static const size_t alignment = 4, size = 4; };
+template<> struct Std140<glm::vec2> { static const size_t alignment = 8, size = 8; };
+template<> struct Std140<glm::vec3> { static const size_t alignment = 16, size = 12; };
+template<> struct Std140<glm::vec4> { static const size_t alignment = 16, size = 16; };
+template<> struct Std140<glm::mat3> { static const size_t alignment = 16, size = 48; };
+template<> struct Std140<glm::mat4> { static const size_t alignment = 16, size = 64; };
+
+inline size_t std140Align(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// Lays values out one after the other the way the matching GLSL block
+// declares its members, for blocks whose layout is only known at runtime.
+// Fixed blocks are plain structs with their offsets checked instead, see
+// FrameData.
+class Std140Writer
+{
+public:
+    Std140Writer(void* data_, size_t capacity_) : data((unsigned char*)data_), capacity(capacity_), offset(0) {}
+    
+    // returns the offset of the member, or the capacity if it did not fit
+    template<typename T>
+    size_t write(const T& value)
+    {
+        size_t start = std140Align(offset, Std140<T>::alignment);
+        if (start + Std140<T>::size > capacity)
+            return capacity;
+        store(data + start, value);
+        offset = start + Std140<T>::size;
+        return start;
+    }
+    
+    // array elements are each rounded up to a vec4
+    template<typename T>
+    size_t writeArray(const T* values, int count)
+    {
+        const size_t stride = std140Align(Std140<T>::size, 16);
+        size_t start = std140Align(offset, 16);
+        if (start + stride * count > capacity)
+            return capacity;
+        for (int i = 0; i < count; i++)
+            store(data + start + stride * i, values[i]);
+        offset = start + stride * count;
+        return start;
+    }
+    
+    // a block is as large as its members rounded up to a vec4
+    size_t size() const { return std140Align(offset, 16); }
+
+private:
+    unsigned char* data;
+    size_t capacity;
+    size_t offset;
+    
+    template<typename T>
+    static void store(unsigned char* to, const T& value) { memcpy(to, &value, sizeof(T)); }
+    static void store(unsigned char* to, const bool& value)
+    {
+        int32_t word = value ? 1 : 0;
+        memcpy(to, &word, 4);
+    }
+    static void store(unsigned char* to, const glm::mat3& value)
+    {
+        for (int column = 0; column < 3; column++)
+            memcpy(to + 16 * column, &value[column], sizeof(glm::vec3));
+    }
+};
+
+#endif /* Std140_hpp */
@@ -0,0 +1,56 @@
+//
+//  Timer.cpp
+//  GameEngine
+//
+
+#include "Timer.hpp"
+#include <atomic>
+#include <chrono>
+
+using namespace std::chrono;
+
+int64_t Timer::nowNanos()
+{
+    static const steady_clock::time_point start = steady_clock::now();
+    return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+}
+
+double Timer::now()
+{
+    return nowNanos() * 1e-9;
+}
+
+// reference point for the tick conversion, taken at startup
+static const int64_t baseNanos = Timer::nowNanos();
+static const int64_t baseTicks = Timer::ticks();
+
+// fixed once a second of history makes the ratio accurate enough
+static std::atomic<double> calibratedPeriod(0.0);
+
+double Timer::tickPeriod()
+{
+#ifdef TIMER_HAS_TSC
+    double period = calibratedPeriod.load(std::memory_order_relaxed);
+    if (period > 0.0)
+        return period;
+    int64_t tickSpan = Timer::ticks() - baseTicks;
+    int64_t nanoSpan = nowNanos() - baseNanos;
+    if (tickSpan <= 0)
+        return 1.0;
+    period = (double)nanoSpan / (double)tickSpan;
+    if (nanoSpan >= 1000000000)
+        calibratedPeriod.store(period, std::memory_order_relaxed);
+    return period;
+#else
+    return 1.0;
+#endif
+}
+
+int64_t Timer::ticksToNanos(int64_t ticks, double period)
+{
+#ifdef TIMER_HAS_TSC
+    return baseNanos + (int64_t)((ticks - baseTicks) * period);
+#else
+    return ticks;
+#endif
+}
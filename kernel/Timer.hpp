@@ -0,0 +1,41 @@
+//
+//  Timer.hpp
+//  GameEngine
+//
+
+#ifndef Timer_hpp
+#define Timer_hpp
+
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIMER_HAS_TSC 1
+#endif
+
+class Timer
+{
+public:
+    // nanoseconds since the first call, from a monotonic clock.
+    // unlike glfwGetTime this also works without a GLFW window (headless)
+    static int64_t nowNanos();
+    // same clock in seconds
+    static double now();
+    
+    // raw cpu timestamp counter, a lot cheaper to read than the clock above.
+    // only meaningful after converting with ticksToNanos
+    static inline int64_t ticks()
+    {
+#ifdef TIMER_HAS_TSC
+        return (int64_t)__rdtsc();
+#else
+        return nowNanos();
+#endif
+    }
+    // nanoseconds per tick, measured against the clock since startup.
+    // refined during the first second, fixed from then on
+    static double tickPeriod();
+    // convert a ticks() value to the nowNanos() clock
+    static int64_t ticksToNanos(int64_t ticks, double period);
+};
+
+#endif /* Timer_hpp */
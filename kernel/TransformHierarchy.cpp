@@ -0,0 +1,487 @@
+//
+//  TransformHierarchy.cpp
+//  GameEngine
+//
+
+#include "TransformHierarchy.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE2__)
+#define TRANSFORM_SIMD 1
+#include <emmintrin.h>
+#endif
+
+const uint32_t TransformHierarchy::INVALID;
+
+static const int32_t NO_PARENT = -1;
+// parent of a destroyed slot until the next rebuild drops it
+static const int32_t DESTROYED = -2;
+static const uint8_t ALL_BUFFERS = (1 << TransformHierarchy::BUFFERS) - 1;
+
+TransformHierarchy::TransformHierarchy() : count(0), structureChanged(false), current(0), updated(0)
+{
+}
+
+uint32_t TransformHierarchy::create(uint32_t parent)
+{
+    int32_t parentSlot = NO_PARENT;
+    if (parent != INVALID)
+    {
+        if (isValid(parent))
+            parentSlot = (int32_t)nodeSlots[parent];
+        else
+            std::cerr << "Transform parent " << parent << " does not exist, created as a root" << std::endl;
+    }
+    uint32_t node;
+    if (!freeNodes.empty())
+    {
+        node = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else
+    {
+        node = (uint32_t)nodeSlots.size();
+        nodeSlots.push_back(INVALID);
+    }
+    // appended for now, rebuild() sorts it in by depth
+    uint32_t slot = count++;
+    nodeSlots[node] = slot;
+    slotNodes.push_back(node);
+    positionX.push_back(0.0f);
+    positionY.push_back(0.0f);
+    positionZ.push_back(0.0f);
+    rotationX.push_back(0.0f);
+    rotationY.push_back(0.0f);
+    rotationZ.push_back(0.0f);
+    rotationW.push_back(1.0f);
+    scaleX.push_back(1.0f);
+    scaleY.push_back(1.0f);
+    scaleZ.push_back(1.0f);
+    radius.push_back(0.0f);
+    layers.push_back(1);
+    parents.push_back(parentSlot);
+    depths.push_back(0);
+    stale.push_back(ALL_BUFFERS);
+    recomputed.push_back(0);
+    structureChanged = true;
+    return node;
+}
+
+void TransformHierarchy::destroy(uint32_t node)
+{
+    if (!isValid(node))
+        return;
+    // the id is handed out again once rebuild() dropped the slot and its children
+    parents[nodeSlots[node]] = DESTROYED;
+    nodeSlots[node] = INVALID;
+    structureChanged = true;
+}
+
+bool TransformHierarchy::setParent(uint32_t node, uint32_t parent)
+{
+    if (!isValid(node) || (parent != INVALID && !isValid(parent)))
+        return false;
+    uint32_t slot = nodeSlots[node];
+    int32_t parentSlot = parent == INVALID ? NO_PARENT : (int32_t)nodeSlots[parent];
+    for (int32_t ancestor = parentSlot; ancestor >= 0; ancestor = parents[ancestor])
+    {
+        if ((uint32_t)ancestor == slot)
+        {
+            std::cerr << "Transform " << parent << " is a child of " << node << ", cannot become its parent" << std::endl;
+            return false;
+        }
+    }
+    parents[slot] = parentSlot;
+    markStale(slot);
+    structureChanged = true;
+    return true;
+}
+
+bool TransformHierarchy::isValid(uint32_t node) const
+{
+    return node < nodeSlots.size() && nodeSlots[node] != INVALID;
+}
+
+void TransformHierarchy::markStale(uint32_t slot)
+{
+    stale[slot] = ALL_BUFFERS;
+    // a pending rebuild marks every level anyway
+    if (!structureChanged)
+        levelStale[depths[slot]] = ALL_BUFFERS;
+}
+
+void TransformHierarchy::setPosition(uint32_t node, const glm::vec3& position)
+{
+    uint32_t slot = nodeSlots[node];
+    positionX[slot] = position.x;
+    positionY[slot] = position.y;
+    positionZ[slot] = position.z;
+    markStale(slot);
+}
+
+void TransformHierarchy::setRotation(uint32_t node, const glm::quat& rotation)
+{
+    uint32_t slot = nodeSlots[node];
+    rotationX[slot] = rotation.x;
+    rotationY[slot] = rotation.y;
+    rotationZ[slot] = rotation.z;
+    rotationW[slot] = rotation.w;
+    markStale(slot);
+}
+
+void TransformHierarchy::setScale(uint32_t node, const glm::vec3& scale)
+{
+    uint32_t slot = nodeSlots[node];
+    scaleX[slot] = scale.x;
+    scaleY[slot] = scale.y;
+    scaleZ[slot] = scale.z;
+    markStale(slot);
+}
+
+glm::vec3 TransformHierarchy::getPosition(uint32_t node) const
+{
+    uint32_t slot = nodeSlots[node];
+    return glm::vec3(positionX[slot], positionY[slot], positionZ[slot]);
+}
+
+glm::quat TransformHierarchy::getRotation(uint32_t node) const
+{
+    uint32_t slot = nodeSlots[node];
+    return glm::quat(rotationW[slot], rotationX[slot], rotationY[slot], rotationZ[slot]);
+}
+
+glm::vec3 TransformHierarchy::getScale(uint32_t node) const
+{
+    uint32_t slot = nodeSlots[node];
+    return glm::vec3(scaleX[slot], scaleY[slot], scaleZ[slot]);
+}
+
+void TransformHierarchy::setBoundingRadius(uint32_t node, float radius_)
+{
+    uint32_t slot = nodeSlots[node];
+    radius[slot] = radius_;
+    markStale(slot);
+}
+
+void TransformHierarchy::setLayers(uint32_t node, uint32_t layers_)
+{
+    layers[nodeSlots[node]] = layers_;
+}
+
+SphereArrays TransformHierarchy::getWorldSpheres() const
+{
+    SphereArrays spheres = { worldX[current].data(), worldY[current].data(), worldZ[current].data(),
+                             worldRadius[current].data(), count };
+    return spheres;
+}
+
+template<typename T>
+static void permute(std::vector<T>& values, const std::vector<uint32_t>& order)
+{
+    std::vector<T> sorted(order.size());
+    for (size_t slot = 0; slot < order.size(); slot++)
+        sorted[slot] = values[order[slot]];
+    values.swap(sorted);
+}
+
+void TransformHierarchy::rebuild()
+{
+    PROFILE_SCOPE("TransformHierarchy::rebuild");
+    std::vector<int32_t> depth(count, INT32_MIN);
+    std::vector<uint32_t> chain;
+    for (uint32_t slot = 0; slot < count; slot++)
+    {
+        // climb to the first ancestor with a known depth, then walk back down
+        uint32_t at = slot;
+        int32_t base;
+        for (;;)
+        {
+            if (depth[at] != INT32_MIN)
+            {
+                base = depth[at];
+                break;
+            }
+            if (parents[at] == DESTROYED)
+            {
+                depth[at] = -1;
+                base = -1;
+                break;
+            }
+            chain.push_back(at);
+            if (parents[at] == NO_PARENT)
+            {
+                base = -1;
+                break;
+            }
+            at = (uint32_t)parents[at];
+        }
+        // below a destroyed node everything is gone
+        bool dead = base == -1 && depth[at] == -1;
+        while (!chain.empty())
+        {
+            uint32_t link = chain.back();
+            chain.pop_back();
+            if (dead)
+                depth[link] = -1;
+            else
+                depth[link] = ++base;
+        }
+    }
+    
+    // counting sort by depth, stable so siblings keep their order
+    std::vector<uint32_t> levelCounts;
+    for (uint32_t slot = 0; slot < count; slot++)
+    {
+        if (depth[slot] < 0)
+            continue;
+        if ((size_t)depth[slot] >= levelCounts.size())
+            levelCounts.resize(depth[slot] + 1, 0);
+        levelCounts[depth[slot]]++;
+    }
+    levels.assign(levelCounts.size() + 1, 0);
+    for (size_t level = 0; level < levelCounts.size(); level++)
+        levels[level + 1] = levels[level] + levelCounts[level];
+    uint32_t alive = levels.back();
+    std::vector<uint32_t> order(alive);
+    std::vector<uint32_t> newSlots(count, INVALID);
+    std::vector<uint32_t> fill(levels.begin(), levels.end() - 1);
+    for (uint32_t slot = 0; slot < count; slot++)
+    {
+        if (depth[slot] < 0)
+        {
+            // ids of nodes that went down with a destroyed ancestor are freed
+            // here, the destroyed node itself already lost its slot
+            uint32_t node = slotNodes[slot];
+            if (nodeSlots[node] == slot)
+                nodeSlots[node] = INVALID;
+            freeNodes.push_back(node);
+            continue;
+        }
+        uint32_t target = fill[depth[slot]]++;
+        order[target] = slot;
+        newSlots[slot] = target;
+    }
+    
+    permute(positionX, order);
+    permute(positionY, order);
+    permute(positionZ, order);
+    permute(rotationX, order);
+    permute(rotationY, order);
+    permute(rotationZ, order);
+    permute(rotationW, order);
+    permute(scaleX, order);
+    permute(scaleY, order);
+    permute(scaleZ, order);
+    permute(radius, order);
+    permute(layers, order);
+    permute(slotNodes, order);
+    std::vector<int32_t> sortedParents(alive);
+    depths.resize(alive);
+    for (uint32_t slot = 0; slot < alive; slot++)
+    {
+        int32_t parent = parents[order[slot]];
+        sortedParents[slot] = parent == NO_PARENT ? NO_PARENT : (int32_t)newSlots[parent];
+        depths[slot] = (uint16_t)depth[order[slot]];
+        nodeSlots[slotNodes[slot]] = slot;
+    }
+    parents.swap(sortedParents);
+    // slots moved, every buffer is rebuilt over the next frames
+    stale.assign(alive, ALL_BUFFERS);
+    recomputed.assign(alive, 0);
+    levelStale.assign(levelCounts.size(), ALL_BUFFERS);
+    count = alive;
+    structureChanged = false;
+}
+
+static inline float maxScaleSquared(const glm::mat4& world)
+{
+    float x = glm::dot(glm::vec3(world[0]), glm::vec3(world[0]));
+    float y = glm::dot(glm::vec3(world[1]), glm::vec3(world[1]));
+    float z = glm::dot(glm::vec3(world[2]), glm::vec3(world[2]));
+    return std::max(x, std::max(y, z));
+}
+
+#ifdef TRANSFORM_SIMD
+// out = parent * local, columns in local, any 4x4 parent.
+static inline void multiply(const float* parent, const __m128 local[4], float* out)
+{
+    __m128 p0 = _mm_loadu_ps(parent);
+    __m128 p1 = _mm_loadu_ps(parent + 4);
+    __m128 p2 = _mm_loadu_ps(parent + 8);
+    __m128 p3 = _mm_loadu_ps(parent + 12);
+    for (int column = 0; column < 4; column++)
+    {
+        __m128 l = local[column];
+        __m128 r = _mm_mul_ps(p0, _mm_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm_add_ps(r, _mm_mul_ps(p1, _mm_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1))));
+        r = _mm_add_ps(r, _mm_mul_ps(p2, _mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2))));
+        r = _mm_add_ps(r, _mm_mul_ps(p3, _mm_shuffle_ps(l, l, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm_storeu_ps(out + 4 * column, r);
+    }
+}
+#endif
+
+// Recompute the slots in [begin, end) that changed or whose parent was
+// recomputed in this pass. Returns how many were.
+uint32_t TransformHierarchy::updateRange(uint32_t begin, uint32_t end, int buffer)
+{
+    uint32_t done = 0;
+    const uint8_t bit = (uint8_t)(1 << buffer);
+    glm::mat4* world = worlds[buffer].data();
+    float* sphereX = worldX[buffer].data();
+    float* sphereY = worldY[buffer].data();
+    float* sphereZ = worldZ[buffer].data();
+    float* sphereRadius = worldRadius[buffer].data();
+    
+    auto needed = [&](uint32_t slot) {
+        int32_t parent = parents[slot];
+        return (stale[slot] & bit) || (parent >= 0 && recomputed[parent]);
+    };
+    auto finish = [&](uint32_t slot) {
+        const glm::mat4& m = world[slot];
+        sphereX[slot] = m[3].x;
+        sphereY[slot] = m[3].y;
+        sphereZ[slot] = m[3].z;
+        sphereRadius[slot] = radius[slot] * std::sqrt(maxScaleSquared(m));
+        stale[slot] &= (uint8_t)~bit;
+        recomputed[slot] = 1;
+        done++;
+    };
+    
+    uint32_t slot = begin;
+#ifdef TRANSFORM_SIMD
+    // four slots at a time: the local matrices are built across lanes from
+    // the arrays, then transposed into one column set per slot
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    for (; slot + 4 <= end; slot += 4)
+    {
+        bool need[4];
+        bool any = false;
+        for (int lane = 0; lane < 4; lane++)
+        {
+            need[lane] = needed(slot + lane);
+            recomputed[slot + lane] = 0;
+            any |= need[lane];
+        }
+        if (!any)
+            continue;
+        
+        __m128 x = _mm_loadu_ps(&rotationX[slot]);
+        __m128 y = _mm_loadu_ps(&rotationY[slot]);
+        __m128 z = _mm_loadu_ps(&rotationZ[slot]);
+        __m128 w = _mm_loadu_ps(&rotationW[slot]);
+        __m128 sx = _mm_loadu_ps(&scaleX[slot]);
+        __m128 sy = _mm_loadu_ps(&scaleY[slot]);
+        __m128 sz = _mm_loadu_ps(&scaleZ[slot]);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+        
+        // rotation columns like glm::mat3_cast, each scaled by its axis
+        __m128 c0[4] = {
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+            _mm_setzero_ps() };
+        __m128 c1[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+            _mm_setzero_ps() };
+        __m128 c2[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+            _mm_setzero_ps() };
+        __m128 c3[4] = {
+            _mm_loadu_ps(&positionX[slot]),
+            _mm_loadu_ps(&positionY[slot]),
+            _mm_loadu_ps(&positionZ[slot]),
+            one };
+        _MM_TRANSPOSE4_PS(c0[0], c0[1], c0[2], c0[3]);
+        _MM_TRANSPOSE4_PS(c1[0], c1[1], c1[2], c1[3]);
+        _MM_TRANSPOSE4_PS(c2[0], c2[1], c2[2], c2[3]);
+        _MM_TRANSPOSE4_PS(c3[0], c3[1], c3[2], c3[3]);
+        
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (!need[lane])
+                continue;
+            uint32_t at = slot + lane;
+            __m128 local[4] = { c0[lane], c1[lane], c2[lane], c3[lane] };
+            float* out = &world[at][0][0];
+            int32_t parent = parents[at];
+            if (parent >= 0)
+                multiply(&world[parent][0][0], local, out);
+            else
+            {
+                for (int column = 0; column < 4; column++)
+                    _mm_storeu_ps(out + 4 * column, local[column]);
+            }
+            finish(at);
+        }
+    }
+#endif
+    for (; slot < end; slot++)
+    {
+        recomputed[slot] = 0;
+        if (!needed(slot))
+            continue;
+        glm::quat rotation(rotationW[slot], rotationX[slot], rotationY[slot], rotationZ[slot]);
+        glm::mat4 local = glm::mat4_cast(rotation);
+        local[0] *= scaleX[slot];
+        local[1] *= scaleY[slot];
+        local[2] *= scaleZ[slot];
+        local[3] = glm::vec4(positionX[slot], positionY[slot], positionZ[slot], 1.0f);
+        int32_t parent = parents[slot];
+        world[slot] = parent >= 0 ? world[parent] * local : local;
+        finish(slot);
+    }
+    return done;
+}
+
+void TransformHierarchy::update(uint64_t frame)
+{
+    PROFILE_SCOPE("TransformHierarchy::update");
+    if (structureChanged)
+        rebuild();
+    current = (int)(frame % BUFFERS);
+    const uint8_t bit = (uint8_t)(1 << current);
+    // only this buffer is resized, the others may still be read
+    worlds[current].resize(count);
+    worldX[current].resize(count);
+    worldY[current].resize(count);
+    worldZ[current].resize(count);
+    worldRadius[current].resize(count);
+    
+    // parents are finished one level before their children, each level
+    // fans out over the workers
+    uint32_t total = 0;
+    bool parentsRecomputed = false;
+    for (size_t level = 0; level + 1 < levels.size(); level++)
+    {
+        uint32_t begin = levels[level];
+        uint32_t end = levels[level + 1];
+        if (!(levelStale[level] & bit) && !parentsRecomputed)
+        {
+            // nothing changed here or above, clear the flags the next level reads
+            std::fill(recomputed.begin() + begin, recomputed.begin() + end, 0);
+            continue;
+        }
+        std::atomic<uint32_t> levelUpdated(0);
+        JobSystem::parallel_for(end - begin, 1024, [&](uint32_t first, uint32_t last) {
+            uint32_t done = updateRange(begin + first, begin + last, current);
+            levelUpdated.fetch_add(done, std::memory_order_relaxed);
+        });
+        levelStale[level] &= (uint8_t)~bit;
+        parentsRecomputed = levelUpdated.load() > 0;
+        total += levelUpdated.load();
+    }
+    updated = total;
+}
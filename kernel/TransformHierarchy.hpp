@@ -0,0 +1,103 @@
+//
+//  TransformHierarchy.hpp
+//  GameEngine
+//
+
+#ifndef TransformHierarchy_hpp
+#define TransformHierarchy_hpp
+
+#include "FrameAllocator.hpp"
+#include "Frustum.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <stdint.h>
+#include <vector>
+
+// Parent/child transforms stored as structure of arrays sorted by depth,
+// so walking the slots in order always reaches a parent before its
+// children and a whole level can be split over worker threads. Only nodes
+// whose local transform changed, and their subtrees, are recomputed, four
+// at a time with SSE.
+//
+// World matrices and bounding spheres are written to one of BUFFERS sets
+// of arrays, picked by the frame index like FrameAllocator's arenas, so a
+// packet can point at them directly and the render thread reads them
+// while the next frames are updated. Everything but the world data is
+// main thread only.
+class TransformHierarchy
+{
+public:
+    static const uint32_t INVALID = 0xFFFFFFFF;
+    static const int BUFFERS = FrameAllocator::FRAMES;
+    
+    TransformHierarchy();
+    
+    // identity local transform, a root without parent
+    uint32_t create(uint32_t parent = INVALID);
+    // destroys the whole subtree
+    void destroy(uint32_t node);
+    // false if that would make the node its own ancestor
+    bool setParent(uint32_t node, uint32_t parent);
+    bool isValid(uint32_t node) const;
+    
+    void setPosition(uint32_t node, const glm::vec3& position);
+    void setRotation(uint32_t node, const glm::quat& rotation);
+    void setScale(uint32_t node, const glm::vec3& scale);
+    glm::vec3 getPosition(uint32_t node) const;
+    glm::quat getRotation(uint32_t node) const;
+    glm::vec3 getScale(uint32_t node) const;
+    // sphere around the local origin, scaled into world space with the node
+    void setBoundingRadius(uint32_t node, float radius);
+    // view layer bits, carried along for culling
+    void setLayers(uint32_t node, uint32_t layers);
+    
+    // once per frame: sorts in nodes added or moved since the last call and
+    // brings the buffer of this frame up to date
+    void update(uint64_t frame);
+    
+    // by slot, valid for the frame of the last update until the same buffer
+    // is updated again BUFFERS frames later. Slots change on structural edits
+    uint32_t getCount() const { return count; }
+    const glm::mat4* getWorldMatrices() const { return worlds[current].data(); }
+    SphereArrays getWorldSpheres() const;
+    const uint32_t* getLayers() const { return layers.data(); }
+    uint32_t getSlot(uint32_t node) const { return nodeSlots[node]; }
+    uint32_t getNode(uint32_t slot) const { return slotNodes[slot]; }
+    // nodes recomputed by the last update
+    uint32_t getUpdatedCount() const { return updated; }
+
+private:
+    // local transform and the tree, by slot
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<float> radius;
+    std::vector<uint32_t> layers;
+    std::vector<int32_t> parents;
+    std::vector<uint16_t> depths;
+    // one bit per buffer that still holds an old world transform
+    std::vector<uint8_t> stale;
+    // set during update when the slot was recomputed, read by its children
+    std::vector<uint8_t> recomputed;
+    std::vector<uint32_t> slotNodes;
+    // first slot of every depth, plus the end
+    std::vector<uint32_t> levels;
+    // buffers with stale slots in each level
+    std::vector<uint8_t> levelStale;
+    
+    std::vector<uint32_t> nodeSlots;
+    std::vector<uint32_t> freeNodes;
+    uint32_t count;
+    bool structureChanged;
+    
+    std::vector<glm::mat4> worlds[BUFFERS];
+    std::vector<float> worldX[BUFFERS], worldY[BUFFERS], worldZ[BUFFERS], worldRadius[BUFFERS];
+    int current;
+    uint32_t updated;
+    
+    void markStale(uint32_t slot);
+    void rebuild();
+    uint32_t updateRange(uint32_t begin, uint32_t end, int buffer);
+};
+
+#endif /* TransformHierarchy_hpp */
@@ -0,0 +1,206 @@
+//
+//  UniformBuffers.cpp
+//  GameEngine
+//
+
+#include "UniformBuffers.hpp"
+#include "FramePacket.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+#include "../imgui/imgui.h"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+struct BlockBinding
+{
+    GLuint binding;
+    size_t size;
+};
+
+static std::unordered_map<std::string, BlockBinding> blocks;
+
+static GLuint frame_buffer = 0;
+static GLuint ring_buffer = 0;
+static size_t segment_size = 0;
+static size_t offset_alignment = 256;
+static int segment = 0;
+static GLsync fences[UniformBuffers::SEGMENTS] = {};
+// used part of the current segment, and where the mapped range starts
+static size_t ring_offset = 0;
+static size_t mapped_offset = 0;
+static unsigned char* mapped = nullptr;
+static bool overflow_reported = false;
+static bool map_failure_reported = false;
+// last frame, written by the render thread and read by the ui
+static std::atomic<size_t> last_used(0);
+static std::atomic<size_t> high_water(0);
+
+void UniformBuffers::init(size_t segmentBytes)
+{
+    if (frame_buffer)
+        return;
+    registerBlock("FrameData", FRAME_BINDING, sizeof(FrameData));
+    registerBlock("MaterialData", MATERIAL_BINDING);
+    
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0)
+        offset_alignment = (size_t)alignment;
+    segment_size = std140Align(segmentBytes, offset_alignment);
+    
+    glGenBuffers(1, &frame_buffer);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, frame_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+    glGenBuffers(1, &ring_buffer);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, ring_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, segment_size * SEGMENTS, NULL, GL_DYNAMIC_DRAW);
+    // stays bound, every program reads it from there
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frame_buffer);
+}
+
+void UniformBuffers::shutdown()
+{
+    if (!frame_buffer)
+        return;
+    flush();
+    for (GLsync& fence : fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+        fence = 0;
+    }
+    GLState::deleteBuffer(frame_buffer);
+    GLState::deleteBuffer(ring_buffer);
+    frame_buffer = 0;
+    ring_buffer = 0;
+}
+
+void UniformBuffers::beginFrame(const FramePacket& frame)
+{
+    if (!frame_buffer)
+        return;
+    PROFILE_SCOPE("UniformBuffers::beginFrame");
+    segment = (segment + 1) % SEGMENTS;
+    if (fences[segment])
+    {
+        // the segment was last used SEGMENTS - 1 frames ago
+        GLenum result = glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+            std::cerr << "Uniform ring segment still in use after 1 s" << std::endl;
+        glDeleteSync(fences[segment]);
+        fences[segment] = 0;
+    }
+    ring_offset = 0;
+    overflow_reported = false;
+    map_failure_reported = false;
+    
+    const FrameView& view = frame.mainView();
+    FrameData data;
+    data.view = view.view;
+    data.projection = view.projection;
+    data.viewProjection = view.viewProjection;
+    data.cameraPosition = view.position;
+    data.time = frame.elapsedTime;
+    // respecifying the whole buffer lets the driver hand out fresh memory
+    // instead of waiting for last frame's draws
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, frame_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), &data, GL_DYNAMIC_DRAW);
+}
+
+void UniformBuffers::endFrame()
+{
+    if (!frame_buffer)
+        return;
+    flush();
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    last_used.store(ring_offset, std::memory_order_relaxed);
+    if (ring_offset > high_water.load(std::memory_order_relaxed))
+        high_water.store(ring_offset, std::memory_order_relaxed);
+}
+
+UniformAllocation UniformBuffers::allocate(size_t size)
+{
+    UniformAllocation allocation = { nullptr, 0, 0 };
+    size_t start = std140Align(ring_offset, offset_alignment);
+    if (!ring_buffer || start + size > segment_size)
+    {
+        if (ring_buffer && !overflow_reported)
+            std::cerr << "Uniform ring segment of " << segment_size << " bytes is full" << std::endl;
+        overflow_reported = true;
+        return allocation;
+    }
+    if (!mapped)
+    {
+        // nothing queued so far reads the rest of the segment, and the fence
+        // in beginFrame made sure the GPU is done with it
+        mapped_offset = start;
+        GLState::bindBuffer(GL_UNIFORM_BUFFER, ring_buffer);
+        mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, segment * segment_size + mapped_offset,
+                                                  segment_size - mapped_offset,
+                                                  GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                                  GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+        if (!mapped)
+        {
+            if (!map_failure_reported)
+                std::cerr << "Cannot map the uniform ring, error 0x" << std::hex << glGetError() << std::dec << std::endl;
+            map_failure_reported = true;
+            return allocation;
+        }
+    }
+    allocation.data = mapped + (start - mapped_offset);
+    allocation.offset = (GLintptr)(segment * segment_size + start);
+    allocation.size = (GLsizeiptr)size;
+    ring_offset = start + size;
+    return allocation;
+}
+
+void UniformBuffers::flush()
+{
+    if (!mapped)
+        return;
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, ring_buffer);
+    // only the written part goes to the GPU
+    glFlushMappedBufferRange(GL_UNIFORM_BUFFER, 0, ring_offset - mapped_offset);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    mapped = nullptr;
+}
+
+void UniformBuffers::bind(GLuint binding, const UniformAllocation& block)
+{
+    if (block.valid())
+        GLState::bindBufferRange(GL_UNIFORM_BUFFER, binding, ring_buffer, block.offset, block.size);
+}
+
+void UniformBuffers::registerBlock(const char* name, GLuint binding, size_t size)
+{
+    blocks[name] = BlockBinding{ binding, size };
+}
+
+bool UniformBuffers::findBlock(const char* name, GLuint& binding, size_t& size)
+{
+    auto found = blocks.find(name);
+    if (found == blocks.end())
+        return false;
+    binding = found->second.binding;
+    size = found->second.size;
+    return true;
+}
+
+size_t UniformBuffers::getRingUsed()
+{
+    return last_used.load(std::memory_order_relaxed);
+}
+
+size_t UniformBuffers::getSegmentSize()
+{
+    return segment_size;
+}
+
+void UniformBuffers::drawImGui()
+{
+    ImGui::Text("FrameData: %d bytes at binding %u, one upload per frame", (int)sizeof(FrameData), FRAME_BINDING);
+    ImGui::Text("Ring: %.1f / %.1f KB used last frame, peak %.1f KB", last_used.load(std::memory_order_relaxed) / 1024.0,
+                segment_size / 1024.0, high_water.load(std::memory_order_relaxed) / 1024.0);
+}
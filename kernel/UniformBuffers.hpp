@@ -0,0 +1,107 @@
+//
+//  UniformBuffers.hpp
+//  GameEngine
+//
+
+#ifndef UniformBuffers_hpp
+#define UniformBuffers_hpp
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include "Std140.hpp"
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+struct FramePacket;
+
+// Per-frame constants every program shares. Declare it in GLSL as
+//
+//     layout(std140) uniform FrameData
+//     {
+//         mat4 view;
+//         mat4 projection;
+//         mat4 viewProjection;
+//         vec3 cameraPosition;
+//         float time;
+//     };
+struct FrameData
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec3 cameraPosition;
+    float time;
+};
+static_assert(offsetof(FrameData, viewProjection) == 128, "FrameData does not match std140");
+static_assert(offsetof(FrameData, time) == 204 && sizeof(FrameData) == 208, "FrameData does not match std140");
+
+// Part of the ring holding one block, valid for the frame it was allocated in.
+struct UniformAllocation
+{
+    void* data;
+    GLintptr offset;
+    GLsizeiptr size;
+    bool valid() const { return data != nullptr; }
+};
+
+// Uniform buffers shared by all programs. FrameData is written once per
+// frame into its own buffer at FRAME_BINDING, so drawing with any number
+// of programs costs one upload instead of matrix uniforms per program.
+// Smaller blocks such as materials are suballocated from a ring split
+// into one segment per frame in flight, a fence keeps a segment from being
+// written while the GPU may still read it. Blocks are bound to the binding
+// points registered for their names when a program links.
+// Everything here runs on the thread that owns the GL context.
+class UniformBuffers
+{
+public:
+    static const GLuint FRAME_BINDING = 0;
+    static const GLuint MATERIAL_BINDING = 1;
+    // one segment being written, up to two still in flight
+    static const int SEGMENTS = 3;
+    
+    static void init(size_t segmentBytes = 256 << 10);
+    static void shutdown();
+    
+    // start of a rendered frame: waits until the GPU released the oldest
+    // segment, which it normally did frames ago, and uploads FrameData
+    static void beginFrame(const FramePacket& frame);
+    // after the last draw of the frame
+    static void endFrame();
+    
+    // data is written directly into the buffer. flush() before drawing
+    // with it, blocks can still be allocated after a flush
+    static UniformAllocation allocate(size_t size);
+    template<typename T>
+    static UniformAllocation allocate(const T& block);
+    static void flush();
+    static void bind(GLuint binding, const UniformAllocation& block);
+    
+    // block name to binding point, picked up by programs linked afterwards.
+    // size is the std140 size the block must have, 0 to not check it
+    static void registerBlock(const char* name, GLuint binding, size_t size = 0);
+    // false if the name was never registered
+    static bool findBlock(const char* name, GLuint& binding, size_t& size);
+    
+    static size_t getRingUsed();
+    static size_t getSegmentSize();
+    static void drawImGui();
+};
+
+template<typename T>
+UniformAllocation UniformBuffers::allocate(const T& block)
+{
+    UniformAllocation allocation = allocate(sizeof(T));
+    if (allocation.valid())
+        memcpy(allocation.data, &block, sizeof(T));
+    return allocation;
+}
+
+#endif /* UniformBuffers_hpp */
@@ -0,0 +1,101 @@
+//
+//  ViewRegistry.cpp
+//  GameEngine
+//
+
+#include "ViewRegistry.hpp"
+#include <cassert>
+#include <iostream>
+
+struct ViewSlot
+{
+    unique_ptr<Camera> camera;
+    const char* name = nullptr;
+    uint32_t layerMask = ViewRegistry::ALL_LAYERS;
+    bool enabled = false;
+};
+
+static ViewSlot& slot(int id)
+{
+    static ViewSlot slots[ViewRegistry::MAX_VIEWS];
+    assert(id >= 0 && id < ViewRegistry::MAX_VIEWS);
+    // the main view always exists
+    if (id == ViewRegistry::MAIN_VIEW && !slots[id].camera)
+    {
+        slots[id].camera = make_unique<Camera>(1280, 960);
+        slots[id].name = "Main";
+        slots[id].enabled = true;
+    }
+    return slots[id];
+}
+
+int ViewRegistry::create(const char* name, int width, int height, uint32_t layerMask)
+{
+    for (int id = MAIN_VIEW + 1; id < MAX_VIEWS; id++)
+    {
+        ViewSlot& view = slot(id);
+        if (view.camera)
+            continue;
+        view.camera = make_unique<Camera>(width, height);
+        view.name = name;
+        view.layerMask = layerMask;
+        view.enabled = true;
+        return id;
+    }
+    std::cerr << "ViewRegistry: no free slot for view " << name << std::endl;
+    return -1;
+}
+
+void ViewRegistry::destroy(int id)
+{
+    if (id == MAIN_VIEW || id < 0 || id >= MAX_VIEWS)
+        return;
+    ViewSlot& view = slot(id);
+    view.camera.reset();
+    view.name = nullptr;
+    view.enabled = false;
+}
+
+bool ViewRegistry::isActive(int id)
+{
+    return id >= 0 && id < MAX_VIEWS && slot(id).camera != nullptr;
+}
+
+Camera& ViewRegistry::getCamera(int id)
+{
+    assert(isActive(id));
+    return *slot(id).camera;
+}
+
+const char* ViewRegistry::getName(int id)
+{
+    return isActive(id) ? slot(id).name : "";
+}
+
+uint32_t ViewRegistry::getLayerMask(int id)
+{
+    return isActive(id) ? slot(id).layerMask : 0;
+}
+
+void ViewRegistry::setLayerMask(int id, uint32_t layerMask)
+{
+    if (isActive(id))
+        slot(id).layerMask = layerMask;
+}
+
+void ViewRegistry::setEnabled(int id, bool enabled)
+{
+    // frames always start with the main view
+    if (id == MAIN_VIEW && !enabled)
+    {
+        std::cerr << "ViewRegistry: the main view cannot be disabled" << std::endl;
+        return;
+    }
+    if (isActive(id))
+        slot(id).enabled = enabled;
+}
+
+bool ViewRegistry::isEnabled(int id)
+{
+    return isActive(id) && slot(id).enabled;
+}
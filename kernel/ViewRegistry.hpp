@@ -0,0 +1,39 @@
+//
+//  ViewRegistry.hpp
+//  GameEngine
+//
+
+#ifndef ViewRegistry_hpp
+#define ViewRegistry_hpp
+
+#include "Camera.hpp"
+#include <stdint.h>
+
+// Every camera the renderer draws from: the main view plus shadow
+// cascades, mirrors, picking or split-screen views. All registered views
+// are culled together in one pass over the scene. Main thread only.
+class ViewRegistry
+{
+public:
+    static const int MAX_VIEWS = 8;
+    static const int MAIN_VIEW = 0;
+    static const uint32_t ALL_LAYERS = 0xffffffffu;
+    
+    // returns the view id, -1 when all slots are taken. name must be a literal.
+    // objects are only drawn into views whose layer mask they share a bit with
+    static int create(const char* name, int width, int height, uint32_t layerMask = ALL_LAYERS);
+    // the main view cannot be destroyed
+    static void destroy(int id);
+    
+    static bool isActive(int id);
+    static Camera& getCamera(int id);
+    static const char* getName(int id);
+    static uint32_t getLayerMask(int id);
+    static void setLayerMask(int id, uint32_t layerMask);
+    // disabled views keep their camera but are skipped by the renderer.
+    // the main view cannot be disabled
+    static void setEnabled(int id, bool enabled);
+    static bool isEnabled(int id);
+};
+
+#endif /* ViewRegistry_hpp */
@@ -8,7 +8,27 @@
 
 #include "Window.hpp"
 #include "Camera.hpp"
+#include "Timer.hpp"
+#include "Profiler.hpp"
+#include "GpuProfiler.hpp"
+#include "JobSystem.hpp"
+#include "FrameAllocator.hpp"
+#include "ProgramCache.hpp"
+#include "ShaderCompiler.hpp"
+#include "ShaderWatcher.hpp"
+#include "UniformBuffers.hpp"
+#include "GLState.hpp"
 #include <glog/logging.h>
+#include <cmath>
+#include <cstring>
+
+#ifndef __APPLE__
+// we only need the surfaceless platform, keep X11 out of the build
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 Window::Window(int width, int height, const char* window_title)
 {
@@ -18,6 +38,31 @@ Window::Window(int width, int height, const char* window_title)
     this->glsl_version = "#version 330";
     r_width = width;
     r_height = height;
+    window = nullptr;
+    headless = false;
+    maxFrames = 0;
+    frameCount = 0;
+    replayGpuFrame = 0;
+    egl_display = nullptr;
+    egl_context = nullptr;
+    threadedRendering = false;
+    lateMouseSampling = false;
+    frameInputTime = 0;
+    input_latency = 0;
+    render_time = 0;
+    fbo = 0;
+    color_buffer = 0;
+    depth_buffer = 0;
+    setFixedTimestep(false);
+}
+
+void Window::setFixedTimestep(bool enabled, double tickRate, int maxSubSteps)
+{
+    this->fixedTimestep = enabled;
+    this->tickInterval = 1.0 / tickRate;
+    this->maxSubSteps = maxSubSteps;
+    accumulator = 0.0;
+    lastTickCount = 0;
 }
 
 bool Window::createWindow()
@@ -73,14 +118,167 @@ bool Window::createWindow()
 
 }
 
+bool Window::createHeadless(int frameCount)
+{
+#ifdef __APPLE__
+    std::cerr << "Headless mode is not supported on macOS" << std::endl;
+    return false;
+#else
+    // Prefer Mesa's surfaceless platform, it needs neither X11 nor a GPU (llvmpipe).
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        std::cerr << "Failed to initialize EGL" << std::endl;
+        return false;
+    }
+    egl_display = display;
+
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context"))
+    {
+        std::cerr << "EGL_KHR_surfaceless_context is not supported" << std::endl;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cerr << "Failed to bind the OpenGL API" << std::endl;
+        return false;
+    }
+    // We never create a surface, so any config will do when the driver
+    // lets us skip it, otherwise ask for a pbuffer capable one.
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    if (!strstr(extensions, "EGL_KHR_no_config_context"))
+    {
+        const EGLint config_attribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLint num_configs = 0;
+        if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) || num_configs == 0)
+        {
+            std::cerr << "Failed to choose an EGL config" << std::endl;
+            return false;
+        }
+    }
+
+    // Ensure that minimum OpenGL version is 3.3
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        std::cerr << "Failed to create EGL context" << std::endl;
+        return false;
+    }
+    egl_context = context;
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        std::cerr << "Failed to make EGL context current" << std::endl;
+        return false;
+    }
+
+    // Initialize GLEW. Core profile needs glewExperimental, and a GLX based
+    // GLEW reports a missing GLX display even though GL entry points loaded.
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (err == GLEW_ERROR_NO_GLX_DISPLAY)
+        err = GLEW_OK;
+#endif
+    if (err != GLEW_OK)
+    {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        return false;
+    }
+    // glewInit may leave a GL error behind on core contexts
+    glGetError();
+
+    headless = true;
+    maxFrames = frameCount;
+    this->frameCount = 0;
+    if (!createFramebuffer())
+        return false;
+
+    GLState::viewport(0, 0, width, height);
+    Camera::get().update_size(width, height);
+
+    return true;
+#endif
+}
+
+bool Window::createFramebuffer()
+{
+    // Offscreen render target replacing the default framebuffer.
+    glGenRenderbuffers(1, &color_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depth_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+        return false;
+    }
+    // leave it bound, everything renders into it from now on
+    return true;
+}
+
 Window::~Window()
 {
+    JobSystem::shutdown();
+    FrameAllocator::shutdown();
+    ShaderWatcher::shutdown();
+    UniformBuffers::shutdown();
+    GpuProfiler::shutdown();
     ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (window)
+        ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
     
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (headless)
+    {
+#ifndef __APPLE__
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &color_buffer);
+        glDeleteRenderbuffers(1, &depth_buffer);
+#endif
+    }
+#ifndef __APPLE__
+    if (egl_display)
+    {
+        eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (egl_context)
+            eglDestroyContext(egl_display, egl_context);
+        eglTerminate(egl_display);
+    }
+#endif
+    if (window)
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 
 }
 
@@ -114,10 +312,9 @@ void Window::resizeCallback(GLFWwindow* window, int width, int height)
     _this->width = width;
     _this->r_width = r_w;
     _this->r_height = r_h;
-    // Set the viewport size.
-    glViewport(0, 0, width, height);
+    // the viewport follows the frame packet, the GL context may be on the render thread
     // set camera projection here
-    Camera::getInstance()->update_size(width, height);
+    Camera::get().update_size(width, height);
 }
 
 void Window::error_callback(int error, const char* description)
@@ -126,11 +323,6 @@ void Window::error_callback(int error, const char* description)
     std::cerr << description << std::endl;
 }
 
-float deltaTime;
-float lastFrame;
-
-
-
 void Window::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
     /*
@@ -138,6 +330,9 @@ void Window::keyCallback(GLFWwindow* window, int key, int scancode, int action,
      */
     // Check for a key press.
     auto _this = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    // held keys are handled by the simulation, replays bring their own input
+    if(action != GLFW_REPEAT && !_this->replay)
+        _this->input.pushKey(key, action);
     if(action == GLFW_PRESS)
     {
         switch(key)
@@ -155,33 +350,25 @@ void Window::keyCallback(GLFWwindow* window, int key, int scancode, int action,
 
 void Window::scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
 {
-    Camera::getInstance()->ProcessMouseScroll(yoffset);
+    auto _this = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    if(!_this->replay)
+        _this->input.pushScroll(xoffset, yoffset);
 }
 
-bool firstMouse;
-float lastX;
-float lastY;
-
 void Window::cursor_position_callback(GLFWwindow *window, double xpos, double ypos)
 {
-    if(firstMouse)
-    {
-        lastX = xpos;
-        lastY = ypos;
-        firstMouse = false;
-    }
-    float xoffset = xpos - lastX;
-    float yoffset = lastY - ypos;
-    
-    lastX = xpos;
-    lastY = ypos;
-    Camera::getInstance()->ProcessMouseMovement(xoffset, yoffset);
+    auto _this = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    if(!_this->replay)
+        _this->input.pushCursor(xpos, ypos);
 }
 
 void Window::setup_callbacks()
 {
     // Set the error callback.
     glfwSetErrorCallback(error_callback);
+    // there is nothing to receive input from
+    if (headless)
+        return;
     // Set the key callback.
     glfwSetKeyCallback(window, keyCallback);
     // Set the window resize callback.
@@ -193,51 +380,221 @@ void Window::setup_callbacks()
 //    glfwSetMouseButtonCallback(window, Window::mouse_button_callback);
 }
 
-void processInput(GLFWwindow* window)
+// Apply one drained input event to the camera.
+void Window::applyInputEvent(const InputEvent& event)
+{
+    // remember the oldest input that ends up in the next frame
+    if(frameInputTime == 0 || event.timestamp < frameInputTime)
+        frameInputTime = event.timestamp;
+    if(recorder)
+        recorder->recordEvent(event);
+    if(event.type == CURSOR_EVENT)
+    {
+        if(firstMouse)
+        {
+            lastX = event.x;
+            lastY = event.y;
+            firstMouse = false;
+        }
+        float xoffset = event.x - lastX;
+        float yoffset = lastY - event.y;
+        
+        lastX = event.x;
+        lastY = event.y;
+        Camera::get().ProcessMouseMovement(xoffset, yoffset);
+    }
+    else if(event.type == SCROLL_EVENT)
+        Camera::get().ProcessMouseScroll(event.y);
+}
+
+// Apply the input events received up to 'until' to the camera.
+void Window::processInput(int64_t until)
 {
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        Camera::getInstance()->ProcessKeyBoard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        Camera::getInstance()->ProcessKeyBoard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        Camera::getInstance()->ProcessKeyBoard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        Camera::getInstance()->ProcessKeyBoard(RIGHT, deltaTime);
+    input.drain(until, [this](const InputEvent& event) { applyInputEvent(event); });
+    
+    // move for exactly as long as each key was held
+    if(input.getHeldTime(GLFW_KEY_W) > 0.0)
+        Camera::get().ProcessKeyBoard(FORWARD, input.getHeldTime(GLFW_KEY_W));
+    if(input.getHeldTime(GLFW_KEY_S) > 0.0)
+        Camera::get().ProcessKeyBoard(BACKWARD, input.getHeldTime(GLFW_KEY_S));
+    if(input.getHeldTime(GLFW_KEY_A) > 0.0)
+        Camera::get().ProcessKeyBoard(LEFT, input.getHeldTime(GLFW_KEY_A));
+    if(input.getHeldTime(GLFW_KEY_D) > 0.0)
+        Camera::get().ProcessKeyBoard(RIGHT, input.getHeldTime(GLFW_KEY_D));
 }
 
 void Window::event_loop()
 {
+    Profiler::setThreadName("Main");
     init();
-    deltaTime = 0.0f;
-    lastFrame = 0.0f;
+    lastFrameTime = Timer::nowNanos();
     firstMouse = true;
-    lastX = width / 2.0f;
-    lastY = height / 2.0f;
+    lastX = width / 2.0;
+    lastY = height / 2.0;
+    // both start from the current camera and clock
+    if (recorder)
+        recorder->begin(lastFrameTime);
+    if (replay)
+        replay->begin(lastFrameTime);
     // imgui setup
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
     
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    if (window)
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init(glsl_version);
     
     ImGui::StyleColorsDark();
 
+    if (threadedRendering)
+    {
+        // create the font atlas while we still own the context, then
+        // hand the context over to the render thread
+        ImGui_ImplOpenGL3_CreateDeviceObjects();
+        makeContextCurrent(false);
+        render_thread = std::thread(&Window::renderThreadLoop, this);
+    }
     
-    
-    while(!glfwWindowShouldClose(window))
+    while(!shouldClose())
     {
         displayCallback(window);
         idleCallback(window);
     }
+    
+    if (threadedRendering)
+    {
+        mailbox.close();
+        render_thread.join();
+        // shutdown code expects the context back on this thread
+        makeContextCurrent(true);
+    }
+    
+    if (replay)
+    {
+        // frames still in flight keep -1
+        collectGpuTimes();
+        replay->writeReport(replay_report.c_str());
+    }
+}
+
+bool Window::startRecording(const char* path)
+{
+    recorder.reset(new InputRecorder());
+    if (!recorder->open(path))
+    {
+        recorder.reset();
+        return false;
+    }
+    return true;
+}
+
+bool Window::startReplay(const char* path, const char* reportPath, bool script)
+{
+    replay.reset(new InputReplay());
+    bool loaded = script ? replay->loadScript(path) : replay->load(path);
+    if (!loaded)
+    {
+        replay.reset();
+        return false;
+    }
+    replay_report = reportPath;
+    return true;
+}
+
+void Window::setThreadedRendering(bool enabled)
+{
+    threadedRendering = enabled;
+}
+
+void Window::makeContextCurrent(bool current)
+{
+#ifndef __APPLE__
+    if (headless)
+    {
+        eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, current ? egl_context : EGL_NO_CONTEXT);
+        return;
+    }
+#endif
+    glfwMakeContextCurrent(current ? window : nullptr);
+}
+
+void Window::renderThreadLoop()
+{
+    Profiler::setThreadName("Render");
+    makeContextCurrent(true);
+    while (const FramePacket* frame = mailbox.acquire())
+    {
+        int64_t start = Timer::nowNanos();
+        renderFrame(*frame);
+        swapBuffers();
+        render_time = Timer::nowNanos() - start;
+        mailbox.release();
+    }
+    makeContextCurrent(false);
+}
+
+// Submit one frame to GL, runs wherever the context is current.
+void Window::renderFrame(const FramePacket& frame)
+{
+    GpuProfiler::beginFrame(frame.frameIndex);
+    GLState::beginFrame();
+    FrameAllocator::beginRender();
+    // edited shaders start rebuilding, the current programs keep drawing
+    ShaderWatcher::poll();
+    // programs whose link finished swap in from their fallback this frame
+    ShaderCompiler::poll();
+    GPU_PROFILE_SCOPE("GPU frame");
+    GLState::viewport(0, 0, frame.width, frame.height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // camera matrices for every program in one upload
+    UniformBuffers::beginFrame(frame);
+    
+    {
+        GPU_PROFILE_SCOPE("RenderEngine::render");
+        render_engine->render(frame);
+    }
+    UniformBuffers::endFrame();
+    
+    // the camera is submitted, the ui does not depend on it
+    if(frame.inputTimestamp != 0)
+        input_latency = Timer::nowNanos() - frame.inputTimestamp;
+    
+    {
+        PROFILE_SCOPE("ImGui_ImplOpenGL3_RenderDrawData");
+        GPU_PROFILE_SCOPE("ImGui_ImplOpenGL3_RenderDrawData");
+        ImGui_ImplOpenGL3_RenderDrawData(const_cast<ImDrawData*>(&frame.drawData));
+    }
+}
+
+bool Window::shouldClose()
+{
+    if (replay && replay->finished())
+        return true;
+    // 0 frames runs until something else stops us
+    if (headless)
+        return maxFrames > 0 && frameCount >= maxFrames;
+    return glfwWindowShouldClose(window);
+}
+
+void Window::swapBuffers()
+{
+    PROFILE_SCOPE("Swap buffers");
+    if (headless)
+    {
+        // nothing to present, just make sure the frame gets submitted
+        glFlush();
+        return;
+    }
+    glfwSwapBuffers(window);
 }
 
 void Window::setup_opengl_settings()
 {
     // Enable depth buffering.
-    glEnable(GL_DEPTH_TEST);
+    GLState::enable(GL_DEPTH_TEST);
     // Related to shaders and z value comparisons for the depth buffer.
-    glDepthFunc(GL_LEQUAL);
+    GLState::depthFunc(GL_LEQUAL);
     // Set polygon drawing mode to fill front and back of each polygon.
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     // Set clear color to black.
@@ -248,41 +605,261 @@ void Window::setup_opengl_settings()
 
 void Window::init()
 {
+    // the main thread is job thread 0, the render thread never schedules jobs
+    JobSystem::init();
+    FrameAllocator::init();
+    ShaderCompiler::init();
+    ShaderWatcher::init();
+    UniformBuffers::init();
     render_engine = make_shared<RenderEngine>();
     render_engine->init();
+    ProgramCache::report();
 }
+
+// Advance the simulation in fixed ticks and return the interpolation alpha.
+// frameEnd is the time the frame started, the last tick may end at most there.
+float Window::stepSimulation(double frameTime, int64_t frameEnd)
+{
+    PROFILE_SCOPE("Simulation");
+    // a breakpoint or a window drag should not be replayed as hundreds of ticks
+    if(frameTime > 0.25)
+        frameTime = 0.25;
+    accumulator += frameTime;
+    
+    int steps = 0;
+    while(accumulator >= tickInterval && steps < maxSubSteps)
+    {
+        accumulator -= tickInterval;
+        // each tick only sees the input that happened before it ended
+        processInput(frameEnd - (int64_t)(accumulator * 1e9));
+        render_engine->update(tickInterval);
+        steps++;
+    }
+    // we could not catch up, drop the backlog instead of spiralling
+    if(accumulator >= tickInterval)
+        accumulator = fmod(accumulator, tickInterval);
+    lastTickCount = steps;
+    
+    return accumulator / tickInterval;
+}
+
 void Window::displayCallback(GLFWwindow *window)
 {
+    Profiler::beginFrame();
+    PROFILE_SCOPE("Frame");
+    // transient memory of the frame that used these arenas FRAMES ago is dead
+    FrameAllocator::beginFrame(frameCount);
     // per frame time logic
-    float currentFrame = glfwGetTime();
-    deltaTime = currentFrame - lastFrame;
-    lastFrame = currentFrame;
+    // keep absolute times as int64 nanoseconds, only the delta is narrowed
+    int64_t frameBegin = Timer::nowNanos();
+    int64_t currentFrame = frameBegin;
+    const ReplayFrame* replayFrame = nullptr;
+    if (replay)
+    {
+        // replayed frames run on the recorded clock, not the wall clock
+        replayFrame = &replay->nextFrame();
+        currentFrame = replayFrame->start;
+        for (const InputEvent& event : replayFrame->events)
+            input.push(event);
+    }
+    double frameTime = (currentFrame - lastFrameTime) * 1e-9;
+    lastFrameTime = currentFrame;
+    float deltaTime = (float)frameTime;
     
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // poll first so this frame already sees the newest input
+    if (!headless)
+    {
+        PROFILE_SCOPE("Poll events");
+        glfwPollEvents();
+    }
     
-    render_engine->render(deltaTime);
-    render_engine->update();
-
-    glfwPollEvents();
+    // with a render thread we fill the mailbox slot in place
+    FramePacket& frame = threadedRendering ? mailbox.beginWrite() : frame_packet;
+    frame.frameIndex = frameCount;
+    frame.elapsedTime = deltaTime;
+    frame.alpha = 1.0f;
+    if(fixedTimestep)
+        frame.alpha = stepSimulation(frameTime, currentFrame);
+    else
+    {
+        processInput(currentFrame);
+        render_engine->update(deltaTime);
+    }
     
     // feed inputs to dear imgui, start new frame
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
+    {
+        PROFILE_SCOPE("ImGui NewFrame");
+        ImGui_ImplOpenGL3_NewFrame();
+        if (headless)
+        {
+            // what the glfw binding would normally fill in
+            ImGuiIO& io = ImGui::GetIO();
+            io.DisplaySize = ImVec2((float)width, (float)height);
+            io.DeltaTime = deltaTime > 0.0f ? deltaTime : 1.0f / 60.0f;
+        }
+        else
+            ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+    }
+    drawPerformanceWindow();
+    {
+        PROFILE_SCOPE("ImGui Render");
+        ImGui::Render();
+        frame.captureDrawData(ImGui::GetDrawData());
+    }
+    
+    // latch the camera as late as possible, right before it is handed to rendering
+    int64_t latchTime = replayFrame ? replayFrame->latch : Timer::nowNanos();
+    latchInput(latchTime);
+    if(recorder)
+        recorder->recordFrame(currentFrame, latchTime);
+    frame.inputTimestamp = frameInputTime;
+    frameInputTime = 0;
+    frame.width = width;
+    frame.height = height;
+    fillViews(frame);
+    render_engine->prepare(frame);
+    
+    if(threadedRendering)
+    {
+        PROFILE_SCOPE("Publish frame");
+        mailbox.publish();
+    }
+    else
+    {
+        int64_t start = Timer::nowNanos();
+        renderFrame(frame);
+        swapBuffers();
+        render_time = Timer::nowNanos() - start;
+    }
+    frameCount++;
+    
+    if(replay)
+    {
+        // the packet may already belong to the render thread
+        replay->recordTiming(frameCount - 1, (Timer::nowNanos() - frameBegin) * 1e-6, render_time * 1e-6);
+        collectGpuTimes();
+    }
+}
+
+// GPU times resolve a few frames late, fill in every replay frame whose
+// result is final by now.
+void Window::collectGpuTimes()
+{
+    double gpuMs;
+    while(replayGpuFrame < frameCount && GpuProfiler::getFrameTime(replayGpuFrame, "GPU frame", gpuMs))
+    {
+        replay->setGpuTime(replayGpuFrame, gpuMs);
+        replayGpuFrame++;
+    }
+}
+
+// Snapshot every enabled view, the main view goes first.
+void Window::fillViews(FramePacket& frame)
+{
+    frame.viewCount = 0;
+    for(int id = 0; id < ViewRegistry::MAX_VIEWS; id++)
+    {
+        if(!ViewRegistry::isEnabled(id))
+            continue;
+        const Camera& camera = ViewRegistry::getCamera(id);
+        FrameView& view = frame.views[frame.viewCount++];
+        view.id = id;
+        view.name = ViewRegistry::getName(id);
+        view.width = camera.getWidth();
+        view.height = camera.getHeight();
+        view.layerMask = ViewRegistry::getLayerMask(id);
+        view.view = camera.get_view();
+        view.projection = camera.get_projection();
+        view.viewProjection = camera.getViewProjectionMatrix();
+        view.position = camera.getPosition();
+        view.visible = nullptr;
+        view.visibleCount = 0;
+        view.queue = nullptr;
+    }
+}
+
+// Apply whatever input arrived since the last tick to the camera.
+void Window::latchInput(int64_t until)
+{
+    PROFILE_SCOPE("Latch input");
+    if(lateMouseSampling && window && !replay)
+    {
+        // the cursor may have moved since glfwPollEvents, sample it again
+        double xpos, ypos;
+        glfwGetCursorPos(window, &xpos, &ypos);
+        if(firstMouse || xpos != lastX || ypos != lastY)
+            input.pushCursor(xpos, ypos);
+    }
+    // fixed ticks move the camera by the time each key was held inside the
+    // tick, so only the look direction is latched here. keys wait for the
+    // ticks of the next frame
+    if(fixedTimestep)
+        input.drainLook(until, [this](const InputEvent& event) { applyInputEvent(event); });
+    else
+        processInput(until);
+}
+
+void Window::setLateMouseSampling(bool enabled)
+{
+    lateMouseSampling = enabled;
+}
+
+void Window::drawPerformanceWindow()
+{
     // frame rate
     ImGui::Begin("Performance Analysis");
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+    if(fixedTimestep)
+        ImGui::Text("Simulation %.0f Hz, %d tick(s) this frame", 1.0 / tickInterval, lastTickCount);
+    if(frame_limiter.getTargetFPS() > 0.0)
+    {
+        ImGui::Text("Frame limiter %.0f FPS, pacing error %.3f ms (avg %.3f ms, max %.3f ms)",
+                    frame_limiter.getTargetFPS(),
+                    frame_limiter.getLastError() * 1000.0,
+                    frame_limiter.getAverageError() * 1000.0,
+                    frame_limiter.getMaxError() * 1000.0);
+        float spin = (float)(frame_limiter.getSpinThreshold() * 1000.0);
+        if(ImGui::SliderFloat("Spin threshold (ms)", &spin, 0.0f, 5.0f))
+            frame_limiter.setSpinThreshold(spin / 1000.0);
+    }
+    ImGui::Text("%s %.3f ms/frame", threadedRendering ? "Render thread" : "Render", render_time * 1e-6);
+    ImGui::Text("Input to submit latency %.3f ms", input_latency * 1e-6);
+    World& world = render_engine->getWorld();
+    ImGui::Text("Entities %u in %d chunks of %d archetypes", world.getEntityCount(), (int)world.getChunkCount(),
+                (int)world.getArchetypeCount());
+    ImGui::Text("Uniform uploads %llu, redundant skipped %llu", (unsigned long long)Program::getUniformUploads(),
+                (unsigned long long)Program::getUniformSkips());
+    RenderStats renderStats = render_engine->getRenderStats();
+    ImGui::Text("Draw calls %u, state changes %u (programs %u, materials %u, vertex arrays %u)",
+                renderStats.drawCalls, renderStats.stateChanges(), renderStats.programs, renderStats.materials,
+                renderStats.vertexArrays);
+    ImGui::Text("GL calls %u, redundant filtered %u", GLState::getIssued(), GLState::getFiltered());
+    if(ShaderCompiler::getPendingCount() > 0)
+        ImGui::Text("Shaders compiling: %d", ShaderCompiler::getPendingCount());
+    ImGui::Checkbox("Re-sample mouse before submit", &lateMouseSampling);
+    if(input.getDroppedEvents() > 0)
+        ImGui::Text("Input events dropped: %llu", (unsigned long long)input.getDroppedEvents());
+    if(ImGui::CollapsingHeader("CPU Profiler", ImGuiTreeNodeFlags_DefaultOpen))
+        Profiler::drawImGui();
+    if(ImGui::CollapsingHeader("GPU Profiler"))
+        GpuProfiler::drawImGui();
+    if(ImGui::CollapsingHeader("Frame Memory"))
+        FrameAllocator::drawImGui();
+    if(ImGui::CollapsingHeader("GL State"))
+        GLState::drawImGui();
+    if(ImGui::CollapsingHeader("Uniform Buffers"))
+        UniformBuffers::drawImGui();
     ImGui::End();
-    
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-    
-    glfwSwapBuffers(window);
-    
-    processInput(window);
 }
 
 void Window::idleCallback(GLFWwindow *window)
 {
-    
+    PROFILE_SCOPE("Frame limiter");
+    frame_limiter.wait();
+}
+
+void Window::setTargetFPS(double fps)
+{
+    frame_limiter.setTargetFPS(fps);
 }
@@ -21,12 +21,19 @@
 // system header
 #include <iostream>
 #include <vector>
+#include <string>
 #include <memory>
+#include <thread>
+#include <atomic>
 
 // project header
 #include "Camera.hpp"
 #include "shader.hpp"
 #include "RenderEngine.hpp"
+#include "FrameLimiter.hpp"
+#include "FrameMailbox.hpp"
+#include "Input.hpp"
+#include "Replay.hpp"
 
 // library header
 #include "../imgui/imgui.h"
@@ -48,6 +55,10 @@ public:
     int r_width;
     int r_height;
     bool createWindow();
+    // offscreen GL context (EGL surfaceless) rendering into a FBO,
+    // the event loop stops after frameCount frames
+    bool createHeadless(int frameCount);
+    bool isHeadless() const { return headless; }
     
     // gl setup
     void print_versions();
@@ -56,12 +67,50 @@ public:
     
     void event_loop();
     
+    // run update() at a fixed tick rate and interpolate render() between ticks
+    void setFixedTimestep(bool enabled, double tickRate = 60.0, int maxSubSteps = 5);
+    // cap the frame rate, 0 runs unlimited
+    void setTargetFPS(double fps);
+    // submit GL from a dedicated thread, must be set before event_loop
+    void setThreadedRendering(bool enabled);
+    // sample the cursor again right before the camera is latched
+    void setLateMouseSampling(bool enabled);
+    // write the input stream and frame times to a file
+    bool startRecording(const char* path);
+    // play a recording (or a flythrough script) back instead of live input,
+    // per frame timings are written to reportPath when it ends
+    bool startReplay(const char* path, const char* reportPath, bool script = false);
+    
 private:
     
     const char* window_title;
     const char* glsl_version;
     GLFWwindow* window;
     
+    // headless backend
+    bool headless;
+    int maxFrames;
+    int frameCount;
+    void* egl_display;
+    void* egl_context;
+    GLuint fbo;
+    GLuint color_buffer;
+    GLuint depth_buffer;
+    bool createFramebuffer();
+    bool shouldClose();
+    void swapBuffers();
+    void makeContextCurrent(bool current);
+    
+    // render thread
+    bool threadedRendering;
+    std::thread render_thread;
+    FrameMailbox mailbox;
+    // packet used when rendering on the main thread
+    FramePacket frame_packet;
+    std::atomic<int64_t> render_time;
+    void renderThreadLoop();
+    void renderFrame(const FramePacket& frame);
+    
     void cleanUp();
     // callback
     static void resizeCallback(GLFWwindow* window, int width, int height);
@@ -72,10 +121,45 @@ private:
     static void error_callback(int error, const char* description);
     
     void displayCallback(GLFWwindow* window);
+    void drawPerformanceWindow();
     void idleCallback(GLFWwindow* window);
     
     void init();
     shared_ptr<RenderEngine> render_engine;
+    
+    // input, pushed by the callbacks and drained by the simulation
+    Input input;
+    bool firstMouse;
+    double lastX;
+    double lastY;
+    bool lateMouseSampling;
+    // oldest event applied since the last frame packet, 0 if none
+    int64_t frameInputTime;
+    std::atomic<int64_t> input_latency;
+    void applyInputEvent(const InputEvent& event);
+    void processInput(int64_t until);
+    void latchInput(int64_t until);
+    void fillViews(FramePacket& frame);
+    
+    // record / replay
+    unique_ptr<InputRecorder> recorder;
+    unique_ptr<InputReplay> replay;
+    std::string replay_report;
+    // oldest frame whose GPU time the replay report is still waiting for
+    int replayGpuFrame;
+    void collectGpuTimes();
+    
+    // fixed timestep simulation
+    bool fixedTimestep;
+    double tickInterval;
+    int maxSubSteps;
+    double accumulator;
+    int lastTickCount;
+    float stepSimulation(double frameTime, int64_t frameEnd);
+    
+    // frame pacing
+    int64_t lastFrameTime;
+    FrameLimiter frame_limiter;
 };
 
 #endif
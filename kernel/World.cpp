@@ -0,0 +1,133 @@
+//
+//  World.cpp
+//  GameEngine
+//
+
+#include "World.hpp"
+#include <cstring>
+
+World::World() : entityCount(0)
+{
+}
+
+World::~World()
+{
+    for (Archetype* archetype : archetypes)
+        archetype->releaseChunks(pool);
+}
+
+Archetype* World::getArchetype(ComponentMask mask)
+{
+    std::unique_ptr<Archetype>& archetype = archetypeLookup[mask];
+    if (!archetype)
+    {
+        archetype.reset(new Archetype(mask));
+        archetypes.push_back(archetype.get());
+    }
+    return archetype.get();
+}
+
+Entity World::allocate(Archetype* archetype)
+{
+    uint32_t index;
+    if (!freeIndices.empty())
+    {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    }
+    else
+    {
+        index = (uint32_t)records.size();
+        records.push_back(EntityRecord{ nullptr, 0, 0, 1 });
+    }
+    EntityRecord& record = records[index];
+    Entity entity = { index, record.generation };
+    record.archetype = archetype;
+    archetype->push(entity, pool, record.chunk, record.row);
+    entityCount++;
+    return entity;
+}
+
+void World::destroy(Entity entity)
+{
+    if (!isAlive(entity))
+        return;
+    EntityRecord& record = records[entity.index];
+    Entity moved = record.archetype->remove(record.chunk, record.row, pool);
+    if (!moved.isNull())
+    {
+        records[moved.index].chunk = record.chunk;
+        records[moved.index].row = record.row;
+    }
+    record.archetype = nullptr;
+    // skip 0 when the generation wraps, it marks null handles
+    if (++record.generation == 0)
+        record.generation = 1;
+    freeIndices.push_back(entity.index);
+    entityCount--;
+}
+
+bool World::isAlive(Entity entity) const
+{
+    return entity.index < records.size() && records[entity.index].generation == entity.generation &&
+        records[entity.index].archetype != nullptr;
+}
+
+void World::move(Entity entity, Archetype* target)
+{
+    EntityRecord& record = records[entity.index];
+    Archetype* source = record.archetype;
+    uint32_t chunk, row;
+    target->push(entity, pool, chunk, row);
+    // copy the components both have, the row is straight memory on both sides
+    for (int component : source->getComponents())
+    {
+        if (target->has(component))
+            memcpy(target->getComponent(chunk, row, component), source->getComponent(record.chunk, record.row, component),
+                   Components::info(component).size);
+    }
+    Entity moved = source->remove(record.chunk, record.row, pool);
+    if (!moved.isNull())
+    {
+        records[moved.index].chunk = record.chunk;
+        records[moved.index].row = record.row;
+    }
+    record.archetype = target;
+    record.chunk = chunk;
+    record.row = row;
+}
+
+void* World::getComponent(Entity entity, int component)
+{
+    const EntityRecord& record = records[entity.index];
+    return record.archetype->getComponent(record.chunk, record.row, component);
+}
+
+void World::refresh(QueryCache& cache)
+{
+    // archetypes are never removed, only the new ones need a look
+    for (; cache.archetypesSeen < archetypes.size(); cache.archetypesSeen++)
+    {
+        Archetype* archetype = archetypes[cache.archetypesSeen];
+        if ((archetype->getMask() & cache.mask) == cache.mask)
+            cache.archetypes.push_back(archetype);
+    }
+}
+
+void World::collectChunks(QueryCache& cache)
+{
+    cache.chunks.clear();
+    for (Archetype* archetype : cache.archetypes)
+    {
+        for (size_t i = 0; i < archetype->getChunkCount(); i++)
+            cache.chunks.push_back(QueryCache::ChunkRef{ archetype, (uint32_t)i });
+    }
+}
+
+size_t World::getChunkCount() const
+{
+    size_t count = 0;
+    for (Archetype* archetype : archetypes)
+        count += archetype->getChunkCount();
+    return count;
+}
@@ -0,0 +1,299 @@
+//
+//  World.hpp
+//  GameEngine
+//
+
+#ifndef World_hpp
+#define World_hpp
+
+#include "Archetype.hpp"
+#include "Component.hpp"
+#include "Entity.hpp"
+#include "JobSystem.hpp"
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+class World;
+
+// Archetypes matching one set of components, refreshed when new
+// archetypes appear, and the flat chunk list handed to worker threads.
+struct QueryCache
+{
+    ComponentMask mask;
+    std::vector<Archetype*> archetypes;
+    size_t archetypesSeen;
+    struct ChunkRef
+    {
+        Archetype* archetype;
+        uint32_t chunk;
+    };
+    std::vector<ChunkRef> chunks;
+};
+
+// Iterates every entity that has all of T, chunk by chunk in memory
+// order. Entities must not be created, destroyed or change components
+// while a view iterates; component values may be written freely.
+template<typename... T>
+class View
+{
+public:
+    View(World* world_, QueryCache* cache_) : world(world_), cache(cache_) {}
+    
+    // function(uint32_t count, const Entity* entities, T*... arrays) once per chunk
+    template<typename F>
+    void eachChunk(const F& function) const;
+    // function(Entity entity, T&... components)
+    template<typename F>
+    void each(const F& function) const;
+    // eachChunk with the chunks spread over the job system, grain is in chunks
+    template<typename F>
+    void parallelEachChunk(const F& function, uint32_t grain = 4) const;
+    template<typename F>
+    void parallelEach(const F& function, uint32_t grain = 4) const;
+    
+    uint32_t count() const;
+
+private:
+    World* world;
+    QueryCache* cache;
+};
+
+// Entities and their components, stored by archetype in 16KB chunks of
+// structure of arrays. Handles are generational. Components are plain
+// data, moving an entity to another archetype copies its row into the
+// target's chunk without allocating per entity. Not thread safe, except
+// that views may write component values from worker threads.
+class World
+{
+public:
+    World();
+    ~World();
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+    
+    // components are value initialized, or copied from the given values
+    template<typename... T>
+    Entity create();
+    template<typename... T>
+    Entity create(const T&... values);
+    // many entities of one archetype at once, handles are written to out if given
+    template<typename... T>
+    void createMany(uint32_t count, Entity* out = nullptr);
+    void destroy(Entity entity);
+    bool isAlive(Entity entity) const;
+    
+    // sets the value if the entity already has the component
+    template<typename T>
+    void add(Entity entity, const T& value = T());
+    template<typename T>
+    void remove(Entity entity);
+    template<typename T>
+    bool has(Entity entity) const;
+    // null if dead or without the component, valid until the entity moves
+    template<typename T>
+    T* get(Entity entity);
+    
+    template<typename... T>
+    View<T...> view();
+    
+    uint32_t getEntityCount() const { return entityCount; }
+    size_t getArchetypeCount() const { return archetypes.size(); }
+    size_t getChunkCount() const;
+    // chunk blocks ever taken from the heap
+    size_t getChunksAllocated() const { return pool.getAllocated(); }
+
+private:
+    template<typename... U>
+    friend class View;
+    
+    struct EntityRecord
+    {
+        Archetype* archetype;
+        uint32_t chunk;
+        uint32_t row;
+        uint32_t generation;
+    };
+    std::vector<EntityRecord> records;
+    std::vector<uint32_t> freeIndices;
+    uint32_t entityCount;
+    
+    std::unordered_map<ComponentMask, std::unique_ptr<Archetype>> archetypeLookup;
+    std::vector<Archetype*> archetypes;
+    std::unordered_map<ComponentMask, std::unique_ptr<QueryCache>> queries;
+    ChunkPool pool;
+    
+    Archetype* getArchetype(ComponentMask mask);
+    Entity allocate(Archetype* archetype);
+    // move the entity's row, the components only the target has are left uninitialized
+    void move(Entity entity, Archetype* target);
+    void refresh(QueryCache& cache);
+    void collectChunks(QueryCache& cache);
+    void* getComponent(Entity entity, int component);
+};
+
+template<typename... T>
+Entity World::create()
+{
+    Entity entity = allocate(getArchetype(Components::mask<T...>()));
+    int expand[] = { 0, (new (getComponent(entity, Components::id<T>())) T(), 0)... };
+    (void)expand;
+    return entity;
+}
+
+template<typename... T>
+Entity World::create(const T&... values)
+{
+    Entity entity = allocate(getArchetype(Components::mask<T...>()));
+    int expand[] = { 0, (new (getComponent(entity, Components::id<T>())) T(values), 0)... };
+    (void)expand;
+    return entity;
+}
+
+template<typename... T>
+void World::createMany(uint32_t count, Entity* out)
+{
+    Archetype* archetype = getArchetype(Components::mask<T...>());
+    records.reserve(records.size() + count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Entity entity = allocate(archetype);
+        int expand[] = { 0, (new (getComponent(entity, Components::id<T>())) T(), 0)... };
+        (void)expand;
+        if (out)
+            out[i] = entity;
+    }
+}
+
+template<typename T>
+void World::add(Entity entity, const T& value)
+{
+    if (!isAlive(entity))
+        return;
+    int component = Components::id<T>();
+    Archetype* source = records[entity.index].archetype;
+    if (!source->has(component))
+    {
+        Archetype* target = source->addEdges[component];
+        if (!target)
+        {
+            target = getArchetype(source->getMask() | (ComponentMask(1) << component));
+            source->addEdges[component] = target;
+            target->removeEdges[component] = source;
+        }
+        move(entity, target);
+    }
+    new (getComponent(entity, component)) T(value);
+}
+
+template<typename T>
+void World::remove(Entity entity)
+{
+    if (!isAlive(entity))
+        return;
+    int component = Components::id<T>();
+    Archetype* source = records[entity.index].archetype;
+    if (!source->has(component))
+        return;
+    Archetype* target = source->removeEdges[component];
+    if (!target)
+    {
+        target = getArchetype(source->getMask() & ~(ComponentMask(1) << component));
+        source->removeEdges[component] = target;
+        target->addEdges[component] = source;
+    }
+    move(entity, target);
+}
+
+template<typename T>
+bool World::has(Entity entity) const
+{
+    return isAlive(entity) && records[entity.index].archetype->has(Components::id<T>());
+}
+
+template<typename T>
+T* World::get(Entity entity)
+{
+    if (!has<T>(entity))
+        return nullptr;
+    return static_cast<T*>(getComponent(entity, Components::id<T>()));
+}
+
+template<typename... T>
+View<T...> World::view()
+{
+    ComponentMask mask = Components::mask<T...>();
+    std::unique_ptr<QueryCache>& cache = queries[mask];
+    if (!cache)
+    {
+        cache.reset(new QueryCache());
+        cache->mask = mask;
+        cache->archetypesSeen = 0;
+    }
+    return View<T...>(this, cache.get());
+}
+
+template<typename... T>
+template<typename F>
+void View<T...>::eachChunk(const F& function) const
+{
+    world->refresh(*cache);
+    for (Archetype* archetype : cache->archetypes)
+    {
+        for (size_t i = 0; i < archetype->getChunkCount(); i++)
+        {
+            const Chunk& chunk = archetype->getChunk(i);
+            function(chunk.count, (const Entity*)archetype->getEntities(chunk), archetype->template getArray<T>(chunk)...);
+        }
+    }
+}
+
+template<typename... T>
+template<typename F>
+void View<T...>::each(const F& function) const
+{
+    eachChunk([&](uint32_t count, const Entity* entities, T*... arrays) {
+        for (uint32_t i = 0; i < count; i++)
+            function(entities[i], arrays[i]...);
+    });
+}
+
+template<typename... T>
+template<typename F>
+void View<T...>::parallelEachChunk(const F& function, uint32_t grain) const
+{
+    world->refresh(*cache);
+    world->collectChunks(*cache);
+    const QueryCache::ChunkRef* chunks = cache->chunks.data();
+    JobSystem::parallel_for((uint32_t)cache->chunks.size(), grain, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            Archetype* archetype = chunks[i].archetype;
+            const Chunk& chunk = archetype->getChunk(chunks[i].chunk);
+            function(chunk.count, (const Entity*)archetype->getEntities(chunk), archetype->template getArray<T>(chunk)...);
+        }
+    });
+}
+
+template<typename... T>
+template<typename F>
+void View<T...>::parallelEach(const F& function, uint32_t grain) const
+{
+    parallelEachChunk([&](uint32_t count, const Entity* entities, T*... arrays) {
+        for (uint32_t i = 0; i < count; i++)
+            function(entities[i], arrays[i]...);
+    }, grain);
+}
+
+template<typename... T>
+uint32_t View<T...>::count() const
+{
+    world->refresh(*cache);
+    uint32_t total = 0;
+    for (Archetype* archetype : cache->archetypes)
+        total += archetype->getEntityCount();
+    return total;
+}
+
+#endif /* World_hpp */
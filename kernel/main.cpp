@@ -11,9 +11,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <memory>
+#include <string.h>
 
 // project library
 #include "Window.hpp"
+#include "Benchmark.hpp"
 
 // third party library
 #include <glog/logging.h>
@@ -23,9 +25,55 @@ int main(int argc, const char * argv[]) {
     int window_width = 1280;
     int window_height = 960;
     const char* window_title = "My Engine";
-    // Create the GLFW window.
+    // --headless <frames>: render offscreen for a fixed number of frames, 0 for no limit
+    // --fps <n>: frame rate cap, 0 for unlimited
+    // --render-thread: submit GL from a dedicated thread
+    // --late-mouse: re-sample the cursor right before the camera is latched
+    // --record <file>: record input and frame times
+    // --replay <file> / --flythrough <script>: play input back, --report <file> gets the timings
+    // --bench <name>: run a benchmark (jobs, culling) and exit
+    bool headless = false;
+    int headless_frames = 0;
+    double target_fps = -1.0;
+    bool render_thread = false;
+    bool late_mouse = false;
+    const char* record_path = nullptr;
+    const char* replay_path = nullptr;
+    bool replay_script = false;
+    const char* report_path = "replay_report.csv";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc)
+        {
+            headless = true;
+            headless_frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            target_fps = atof(argv[++i]);
+        else if (strcmp(argv[i], "--render-thread") == 0)
+            render_thread = true;
+        else if (strcmp(argv[i], "--late-mouse") == 0)
+            late_mouse = true;
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            record_path = argv[++i];
+        else if ((strcmp(argv[i], "--replay") == 0 || strcmp(argv[i], "--flythrough") == 0) && i + 1 < argc)
+        {
+            replay_script = strcmp(argv[i], "--flythrough") == 0;
+            replay_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+            report_path = argv[++i];
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+            return Benchmark::run(argv[++i]) ? 0 : -1;
+    }
+    // benchmarks run unlimited, interactive sessions should not burn a core
+    if (target_fps < 0.0)
+        target_fps = headless || replay_path ? 0.0 : 144.0;
+    // Create the GLFW window, or an offscreen context on the build farm.
     std::unique_ptr<Window> render_window = std::make_unique<Window>(window_width, window_height, window_title);
-    if(!render_window->createWindow())
+    bool created = headless ? render_window->createHeadless(headless_frames)
+                            : render_window->createWindow();
+    if(!created)
     {
         LOG(ERROR) << "window intialization error!";
         return -1;
@@ -37,6 +85,15 @@ int main(int argc, const char * argv[]) {
     render_window->setup_callbacks();
     // opengl setup
     render_window->setup_opengl_settings();
+    // simulate at a fixed 60 Hz regardless of the display rate
+    render_window->setFixedTimestep(true, 60.0);
+    render_window->setTargetFPS(target_fps);
+    render_window->setThreadedRendering(render_thread);
+    render_window->setLateMouseSampling(late_mouse);
+    if (record_path && !render_window->startRecording(record_path))
+        return -1;
+    if (replay_path && !render_window->startReplay(replay_path, report_path, replay_script))
+        return -1;
 
     render_window->event_loop();
 }
@@ -7,198 +7,260 @@
 //
 
 #include "shader.hpp"
+#include "ShaderCompiler.hpp"
+#include "ShaderWatcher.hpp"
+#include "UniformBuffers.hpp"
+#include "GLState.hpp"
 
-Program::Program(const char* vertex_file_path, const char* frag_file_path)
+std::atomic<uint64_t> Program::uniformUploads(0);
+std::atomic<uint64_t> Program::uniformSkips(0);
+static std::atomic<uint32_t> next_sort_id(0);
+
+Program::Program()
+{
+    id = 0;
+    status = FAILED;
+    fallback = nullptr;
+    sortId = next_sort_id.fetch_add(1, std::memory_order_relaxed);
+}
+Program::Program(const char* vertex_file_path, const char* frag_file_path) : Program()
+{
+    const char* paths[] = { vertex_file_path, frag_file_path };
+    const ShaderType types[] = { vertex, fragment };
+    ShaderCompiler::submit(*this, paths, types, 2);
+    ShaderCompiler::finish(*this);
+}
+Program::Program(const char *vertex_file_path, const char *fragment_file_path, const char *geometry_file_path) : Program()
 {
-    id = LoadShaders(vertex_file_path, frag_file_path);
+    const char* paths[] = { vertex_file_path, fragment_file_path, geometry_file_path };
+    const ShaderType types[] = { vertex, fragment, geometry };
+    ShaderCompiler::submit(*this, paths, types, 3);
+    ShaderCompiler::finish(*this);
 }
-Program::Program(const char *vertex_file_path, const char *fragment_file_path, const char *geometry_file_path)
+Program::~Program()
 {
-    id = LoadShaders(vertex_file_path, fragment_file_path, geometry_file_path);
+    // a READY program may still have a reload in flight
+    ShaderCompiler::cancel(*this);
+    ShaderWatcher::unwatch(*this);
+    if (id)
+        GLState::deleteProgram(id);
 }
 
-GLuint Program::LoadSingleShader(const char * shaderFilePath, ShaderType type)
-{
-    // Create a shader id.
-    GLuint shaderID = 0;
-    if (type == vertex)
-        shaderID = glCreateShader(GL_VERTEX_SHADER);
-    else if (type == fragment)
-        shaderID = glCreateShader(GL_FRAGMENT_SHADER);
-    else if (type == geometry)
-        shaderID = glCreateShader(GL_GEOMETRY_SHADER);
+void Program::use()
+{
+    // walk the fallbacks until one is ready, a few levels are plenty
+    const Program* program = this;
+    for (int depth = 0; program && program->status != READY && depth < 4; depth++)
+        program = program->fallback;
+    GLState::useProgram(program && program->status == READY ? program->id : 0);
+}
+void Program::unuse()
+{
+    GLState::useProgram(0);
+}
 
-    // Try to read shader codes from the shader file.
-    std::string shaderCode;
-    std::ifstream shaderStream(shaderFilePath, std::ios::in);
-    if (shaderStream.is_open())
-    {
-        std::string Line = "";
-        while (getline(shaderStream, Line))
-            shaderCode += "\n" + Line;
-        shaderStream.close();
-    }
-    else
+// Look up every active uniform once, so setting one never asks the driver.
+// Slots are kept across relinks so handles taken before a reload still
+// work, uniforms that went away just get location -1.
+void Program::reflectUniforms()
+{
+    for (Uniform& uniform : uniforms)
     {
-        std::cerr << "Impossible to open " << shaderFilePath << ". "
-            << "Check to make sure the file exists and you passed in the "
-            << "right filepath!"
-            << std::endl;
-        return 0;
+        uniform.location = -1;
+        uniform.cached = false;
     }
-
-    GLint Result = GL_FALSE;
-    int InfoLogLength;
-
-    // Compile Shader.
-    std::cerr << "Compiling shader: " << shaderFilePath << std::endl;
-    char const * sourcePointer = shaderCode.c_str();
-    glShaderSource(shaderID, 1, &sourcePointer, NULL);
-    glCompileShader(shaderID);
+    if (id == 0)
+        return;
+    bindUniformBlocks();
     
-    // Check Shader.
-    glGetShaderiv(shaderID, GL_COMPILE_STATUS, &Result);
-    glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    if (InfoLogLength > 0)
-    {
-        std::vector<char> shaderErrorMessage(InfoLogLength + 1);
-        glGetShaderInfoLog(shaderID, InfoLogLength, NULL, shaderErrorMessage.data());
-        std::string msg(shaderErrorMessage.begin(), shaderErrorMessage.end());
-        std::cerr << msg << std::endl;
-        return 0;
-    }
-    else
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength + 1);
+    for (GLint i = 0; i < count; i++)
     {
-        if (type == vertex)
-            printf("Successfully compiled vertex shader!\n");
-        else if (type == fragment)
-            printf("Successfully compiled fragment shader!\n");
-        else if(type == geometry)
-            printf("Successfully compiled geometry shader!\n");
+        Uniform uniform;
+        GLsizei length = 0;
+        glGetActiveUniform(id, (GLuint)i, (GLsizei)name.size(), &length, &uniform.size, &uniform.type, name.data());
+        uniform.location = glGetUniformLocation(id, name.data());
+        // members of uniform blocks have no location, they are set through buffers
+        if (uniform.location < 0)
+            continue;
+        uniform.cached = false;
+        uniform.mismatchReported = false;
+        std::string key(name.data(), length);
+        int slot;
+        auto found = uniformLookup.find(key);
+        if (found != uniformLookup.end())
+            slot = found->second;
+        else
+        {
+            slot = (int)uniforms.size();
+            uniforms.push_back(uniform);
+            uniformLookup[key] = slot;
+        }
+        uniforms[slot] = uniform;
+        // arrays are reported as "name[0]", accept the bare name as well.
+        // only that suffix, "lights[0].color" is not "lights"
+        if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+            uniformLookup[key.substr(0, key.size() - 3)] = slot;
     }
-
-    return shaderID;
 }
 
-GLuint Program::LoadShaders(const char * vertexFilePath, const char * fragmentFilePath)
+// Point the blocks the program declares at the binding points registered
+// for their names, so nothing has to be bound per program.
+void Program::bindUniformBlocks()
 {
-    // Create the vertex shader and fragment shader.
-    GLuint vertexShaderID = LoadSingleShader(vertexFilePath, vertex);
-    GLuint fragmentShaderID = LoadSingleShader(fragmentFilePath, fragment);
-
-    // Check both shaders.
-    if (vertexShaderID == 0 || fragmentShaderID == 0) return 0;
-
-    GLint Result = GL_FALSE;
-    int InfoLogLength;
-
-    // Link the program.
-    printf("Linking program\n");
-    GLuint programID = glCreateProgram();
-    glAttachShader(programID, vertexShaderID);
-    glAttachShader(programID, fragmentShaderID);
-    glLinkProgram(programID);
-
-    // Check the program.
-    glGetProgramiv(programID, GL_LINK_STATUS, &Result);
-    glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    if (InfoLogLength > 0)
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    std::vector<char> name(maxLength + 1);
+    for (GLint i = 0; i < count; i++)
     {
-        std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
-        glGetProgramInfoLog(programID, InfoLogLength, NULL, ProgramErrorMessage.data());
-        std::string msg(ProgramErrorMessage.begin(), ProgramErrorMessage.end());
-        std::cerr << msg << std::endl;
-        glDeleteProgram(programID);
-        return 0;
+        glGetActiveUniformBlockName(id, (GLuint)i, (GLsizei)name.size(), NULL, name.data());
+        GLuint binding = 0;
+        size_t expected = 0;
+        if (!UniformBuffers::findBlock(name.data(), binding, expected))
+        {
+            std::cerr << "Uniform block " << name.data() << " has no registered binding" << std::endl;
+            continue;
+        }
+        GLint size = 0;
+        glGetActiveUniformBlockiv(id, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        if (expected && (size_t)size != expected)
+            std::cerr << "Uniform block " << name.data() << " is " << size << " bytes, expected "
+                << expected << ", is it declared std140?" << std::endl;
+        glUniformBlockBinding(id, (GLuint)i, binding);
     }
-    else
-    {
-        printf("Successfully linked program!\n");
-    }
-
-    // Detach and delete the shaders as they are no longer needed.
-    glDetachShader(programID, vertexShaderID);
-    glDetachShader(programID, fragmentShaderID);
-    glDeleteShader(vertexShaderID);
-    glDeleteShader(fragmentShaderID);
-
-    return programID;
 }
-GLuint Program::LoadShaders(const char *vertex_file_path, const char *fragment_file_path, const char *geometry_file_path)
-{
-    // Create the vertex shader and fragment shader.
-    GLuint vertexShaderID = LoadSingleShader(vertex_file_path, vertex);
-    GLuint fragmentShaderID = LoadSingleShader(fragment_file_path, fragment);
-    GLuint geometryShaderID = LoadSingleShader(geometry_file_path, geometry);
-
-    // Check both shaders.
-    if (vertexShaderID == 0 || fragmentShaderID == 0 || geometryShaderID == 0) return 0;
-
-    GLint Result = GL_FALSE;
-    int InfoLogLength;
 
-    // Link the program.
-    printf("Linking program\n");
-    GLuint programID = glCreateProgram();
-    glAttachShader(programID, vertexShaderID);
-    glAttachShader(programID, fragmentShaderID);
-    glAttachShader(programID, geometryShaderID);
-    glLinkProgram(programID);
-
-    // Check the program.
-    glGetProgramiv(programID, GL_LINK_STATUS, &Result);
-    glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    if (InfoLogLength > 0)
+bool Program::matchesType(GLenum declared, GLenum requested)
+{
+    if (declared == requested)
+        return true;
+    // samplers are set like ints, GLSL bools accept ints too
+    if (requested == GL_INT)
     {
-        std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
-        glGetProgramInfoLog(programID, InfoLogLength, NULL, ProgramErrorMessage.data());
-        std::string msg(ProgramErrorMessage.begin(), ProgramErrorMessage.end());
-        std::cerr << msg << std::endl;
-        glDeleteProgram(programID);
-        return 0;
+        switch (declared)
+        {
+            case GL_BOOL:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_3D:
+            case GL_SAMPLER_CUBE:
+            case GL_SAMPLER_2D_SHADOW:
+            case GL_SAMPLER_2D_ARRAY:
+            case GL_SAMPLER_2D_ARRAY_SHADOW:
+            case GL_SAMPLER_CUBE_SHADOW:
+            case GL_INT_SAMPLER_2D:
+            case GL_UNSIGNED_INT_SAMPLER_2D:
+                return true;
+            default:
+                return false;
+        }
     }
-    else
+    return false;
+}
+
+int Program::findUniform(const char* name, GLenum type) const
+{
+    auto found = uniformLookup.find(name);
+    if (found == uniformLookup.end() || uniforms[found->second].location < 0)
+        return -1;
+    Uniform& uniform = uniforms[found->second];
+    if (!matchesType(uniform.type, type))
     {
-        printf("Successfully linked program!\n");
+        if (!uniform.mismatchReported)
+        {
+            std::cerr << "Uniform " << name << " has GL type 0x" << std::hex << uniform.type
+                << ", requested as 0x" << type << std::dec << std::endl;
+            uniform.mismatchReported = true;
+        }
+        return -1;
     }
+    return found->second;
+}
 
-    // Detach and delete the shaders as they are no longer needed.
-    glDetachShader(programID, vertexShaderID);
-    glDetachShader(programID, fragmentShaderID);
-    glDetachShader(programID, geometryShaderID);
-    glDeleteShader(vertexShaderID);
-    glDeleteShader(fragmentShaderID);
-    glDeleteShader(geometryShaderID);
-
-    return programID;
+bool Program::hasUniform(const char* name) const
+{
+    auto found = uniformLookup.find(name);
+    return found != uniformLookup.end() && uniforms[found->second].location >= 0;
 }
-void Program::use()
+
+uint64_t Program::getUniformUploads()
 {
-    glUseProgram(id);
+    return uniformUploads.load(std::memory_order_relaxed);
 }
-void Program::unuse()
+
+uint64_t Program::getUniformSkips()
 {
-    glUseProgram(0);
+    return uniformSkips.load(std::memory_order_relaxed);
 }
 
+// Setters by name go through the reflected table as well. Unknown names
+// are ignored, like glUniform* with location -1.
 void Program::setBool(const char *name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(id, name), (int)value);
+    int slot = findUniform(name, GL_INT);
+    if (slot >= 0)
+        setUniform(slot, (int)value);
 }
 
 void Program::setInt(const char *name, int value) const
 {
-    glUniform1i(glGetUniformLocation(id, name), value);
+    int slot = findUniform(name, GL_INT);
+    if (slot >= 0)
+        setUniform(slot, value);
 }
 void Program::setFloat(const char *name, float value) const
 {
-    glUniform1f(glGetUniformLocation(id, name), value);
+    int slot = findUniform(name, GL_FLOAT);
+    if (slot >= 0)
+        setUniform(slot, value);
 }
 void Program::setVec3(const char *name, glm::vec3 value) const
 {
-    glUniform3fv(glGetUniformLocation(id, name), 1, &value[0]);
+    int slot = findUniform(name, GL_FLOAT_VEC3);
+    if (slot >= 0)
+        setUniform(slot, value);
 }
 void Program::setMat4(const char *name, glm::mat4 value) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(id, name), 1, GL_FALSE, &value[0][0]);
+    int slot = findUniform(name, GL_FLOAT_MAT4);
+    if (slot >= 0)
+        setUniform(slot, value);
+}
+
+void uploadUniform(GLint location, const bool& value)
+{
+    glUniform1i(location, (int)value);
+}
+void uploadUniform(GLint location, const int& value)
+{
+    glUniform1i(location, value);
+}
+void uploadUniform(GLint location, const float& value)
+{
+    glUniform1f(location, value);
+}
+void uploadUniform(GLint location, const glm::vec2& value)
+{
+    glUniform2fv(location, 1, &value[0]);
+}
+void uploadUniform(GLint location, const glm::vec3& value)
+{
+    glUniform3fv(location, 1, &value[0]);
+}
+void uploadUniform(GLint location, const glm::vec4& value)
+{
+    glUniform4fv(location, 1, &value[0]);
+}
+void uploadUniform(GLint location, const glm::mat3& value)
+{
+    glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
+}
+void uploadUniform(GLint location, const glm::mat4& value)
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
 }
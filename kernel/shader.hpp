@@ -20,30 +20,175 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <unordered_map>
 #include <glm/glm.hpp>
 
+class Program;
+
+// Pre-resolved uniform of a linked program. Setting it costs no string
+// lookup, and a value equal to the last one set is not uploaded again.
+// Points at its program, so the program must stay where it is.
+template<typename T>
+class UniformHandle
+{
+public:
+    UniformHandle() : program(nullptr), slot(-1) {}
+    bool valid() const { return slot >= 0; }
+    // the program has to be in use, like glUniform*
+    void set(const T& value) const;
+    
+private:
+    friend class Program;
+    UniformHandle(Program* program_, int slot_) : program(program_), slot(slot_) {}
+    Program* program;
+    int slot;
+};
+
 class Program{
 public:
     enum ShaderType { vertex, fragment, geometry };
+    // PENDING while ShaderCompiler still builds it
+    enum Status { PENDING, READY, FAILED };
     GLuint id;
-    Program(){}
+    Program();
+    // build synchronously, see ShaderCompiler::submit for the async path
     Program(const char* vertex_file_path, const char* frag_file_path);
     Program(const char* vertex_file_path, const char* frag_file_path, const char* geo_file_path);
+    ~Program();
+    // handles and the compiler point at programs, they cannot move
+    Program(const Program&) = delete;
+    Program& operator=(const Program&) = delete;
+    // binds the fallback instead while this program is not ready
     void use();
     void unuse();
     
+    Status getStatus() const { return status; }
+    bool isReady() const { return status == READY; }
+    // drawn with while this program is pending or failed to build
+    void setFallback(const Program* fallback_) { fallback = fallback_; }
+    // what the program was last submitted with, for rebuilding it
+    const std::vector<std::string>& getSourcePaths() const { return sourcePaths; }
+    // unique for the program's lifetime and set at construction, unlike the
+    // GL name, which changes on every rebuild and gets reused. any thread
+    uint32_t getSortId() const { return sortId; }
+    
     void setBool(const char* name, bool value) const;
     void setInt(const char* name, int value) const;
     void setFloat(const char* name, float value) const;
     void setVec3(const char* name, glm::vec3 value) const;
     void setMat4(const char* name, glm::mat4 value) const;
+    
+    // invalid handle if the program has no active uniform of that name and
+    // type, which is also the case until it is ready. handles stay valid
+    // when the program is rebuilt
+    template<typename T>
+    UniformHandle<T> getUniform(const char* name);
+    bool hasUniform(const char* name) const;
+    
+    // uploads since startup, and the ones dropped because the value did not change
+    static uint64_t getUniformUploads();
+    static uint64_t getUniformSkips();
+    
 private:
+    template<typename T>
+    friend class UniformHandle;
+    friend class ShaderCompiler;
+    
+    Status status;
+    const Program* fallback;
+    uint32_t sortId;
+    std::vector<std::string> sourcePaths;
+    std::vector<ShaderType> sourceTypes;
+    std::vector<std::string> sourceDefines;
+    
+    // active uniform reflected after link, with the last value set
+    struct Uniform
+    {
+        GLint location;
+        GLenum type;
+        GLint size;
+        bool cached;
+        // a setter asked for another type, only said once per link
+        bool mismatchReported;
+        // large enough for a mat4
+        unsigned char value[64];
+    };
+    // the shadow values change in the const setters
+    mutable std::vector<Uniform> uniforms;
+    std::unordered_map<std::string, int> uniformLookup;
+    static std::atomic<uint64_t> uniformUploads;
+    static std::atomic<uint64_t> uniformSkips;
+    
+    void reflectUniforms();
+    void bindUniformBlocks();
+    int findUniform(const char* name, GLenum type) const;
+    template<typename T>
+    void setUniform(int slot, const T& value) const;
+    static bool matchesType(GLenum declared, GLenum requested);
     
-    GLuint LoadSingleShader(const char * shaderFilePath, ShaderType type);
-    GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path);
-    GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path, const char * geometry_file_path);
     
 };
 
 
+// GL type a uniform must be declared with for each C++ type
+template<typename T> struct UniformType;
+template<> struct UniformType<bool> { static const GLenum value = GL_BOOL; };
+template<> struct UniformType<int> { static const GLenum value = GL_INT; };
+template<> struct UniformType<float> { static const GLenum value = GL_FLOAT; };
+template<> struct UniformType<glm::vec2> { static const GLenum value = GL_FLOAT_VEC2; };
+template<> struct UniformType<glm::vec3> { static const GLenum value = GL_FLOAT_VEC3; };
+template<> struct UniformType<glm::vec4> { static const GLenum value = GL_FLOAT_VEC4; };
+template<> struct UniformType<glm::mat3> { static const GLenum value = GL_FLOAT_MAT3; };
+template<> struct UniformType<glm::mat4> { static const GLenum value = GL_FLOAT_MAT4; };
+
+void uploadUniform(GLint location, const bool& value);
+void uploadUniform(GLint location, const int& value);
+void uploadUniform(GLint location, const float& value);
+void uploadUniform(GLint location, const glm::vec2& value);
+void uploadUniform(GLint location, const glm::vec3& value);
+void uploadUniform(GLint location, const glm::vec4& value);
+void uploadUniform(GLint location, const glm::mat3& value);
+void uploadUniform(GLint location, const glm::mat4& value);
+
+template<typename T>
+void UniformHandle<T>::set(const T& value) const
+{
+    if (program)
+        program->setUniform(slot, value);
+}
+
+template<typename T>
+UniformHandle<T> Program::getUniform(const char* name)
+{
+    int slot = findUniform(name, UniformType<T>::value);
+    if (slot < 0)
+        return UniformHandle<T>();
+    return UniformHandle<T>(this, slot);
+}
+
+template<typename T>
+void Program::setUniform(int slot, const T& value) const
+{
+    static_assert(sizeof(T) <= sizeof(Uniform::value), "uniform value too large");
+    // a pending program has no uniforms yet, the fallback is bound instead
+    if (status != READY)
+        return;
+    Uniform& uniform = uniforms[slot];
+    // dropped by a rebuild
+    if (uniform.location < 0)
+        return;
+    if (uniform.cached && memcmp(uniform.value, &value, sizeof(T)) == 0)
+    {
+        uniformSkips.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    memcpy(uniform.value, &value, sizeof(T));
+    uniform.cached = true;
+    uploadUniform(uniform.location, value);
+    uniformUploads.fetch_add(1, std::memory_order_relaxed);
+}
+
 #endif /* shader_hpp */